@@ -0,0 +1,42 @@
+# Turns every file in SHADER_DIRECTORY into a string_view table written to OUTPUT.
+# Usage: cmake -DSHADER_DIRECTORY=<dir> -DOUTPUT=<header> -P embed_shaders.cmake
+
+# MSVC limits a single string literal to 16380 bytes, longer sources are split into adjacent literals.
+set(CHUNK_SIZE 8000)
+
+file(GLOB SHADER_SOURCES "${SHADER_DIRECTORY}/*")
+list(SORT SHADER_SOURCES)
+
+set(content "// Generated by cmake/embed_shaders.cmake, do not edit.\n")
+string(APPEND content "#ifndef EMBEDDED_SHADERS_HPP\n#define EMBEDDED_SHADERS_HPP\n\n#include <string_view>\n\n")
+string(APPEND content "struct EmbeddedShader\n{\n    std::string_view name;\n    std::string_view source;\n};\n\n")
+string(APPEND content "inline constexpr EmbeddedShader EMBEDDED_SHADERS[]{\n")
+
+foreach(source ${SHADER_SOURCES})
+    get_filename_component(name "${source}" NAME)
+    file(READ "${source}" text)
+    string(LENGTH "${text}" length)
+    string(APPEND content "    {\"${name}\",\n")
+    set(offset 0)
+    while(offset LESS length)
+        string(SUBSTRING "${text}" ${offset} ${CHUNK_SIZE} chunk)
+        string(APPEND content "     R\"shader(${chunk})shader\"\n")
+        math(EXPR offset "${offset} + ${CHUNK_SIZE}")
+    endwhile()
+    if(length EQUAL 0)
+        string(APPEND content "     \"\"\n")
+    endif()
+    string(APPEND content "    },\n")
+endforeach()
+
+string(APPEND content "};\n\n#endif\n")
+
+# The header is only rewritten when its content differs. Any real shader edit changes it and rebuilds its
+# dependents. A shader that is saved or checked out unchanged leaves the header's timestamp alone, so
+# nothing recompiles.
+if(EXISTS "${OUTPUT}")
+    file(READ "${OUTPUT}" previous)
+endif()
+if(NOT "${previous}" STREQUAL "${content}")
+    file(WRITE "${OUTPUT}" "${content}")
+endif()
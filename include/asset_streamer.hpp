@@ -0,0 +1,353 @@
+#ifndef ASSET_STREAMER_HPP
+#define ASSET_STREAMER_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "frame_arena.hpp"
+#include "logger.hpp"
+#include "mesh.hpp"
+#include "mesh_loader.hpp"
+#include "model.hpp"
+#include "profiler.hpp"
+#include "thread_pool.hpp"
+
+// GPU buffers of one streamed mesh. AssetStreamer creates them once the mesh is decoded and fills them over
+// as many frames as the upload budget needs, the mesh is drawable once resident.
+class StreamedMesh
+{
+public:
+    StreamedMesh() = default;
+    StreamedMesh(const StreamedMesh &) = delete;
+    StreamedMesh &operator=(const StreamedMesh &) = delete;
+    ~StreamedMesh()
+    {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+    };
+
+    bool is_resident() const { return resident; };
+    const Bounds &get_bounds() const { return bounds; };
+
+    void draw() const
+    {
+        glBindVertexArray(VAO);
+        glDrawElements(GL_TRIANGLES, static_cast<int32_t>(index_count), GL_UNSIGNED_INT, nullptr);
+    };
+
+private:
+    friend class AssetStreamer;
+
+    uint32_t VAO{0};
+    uint32_t VBO{0};
+    uint32_t EBO{0};
+    uint32_t index_count{0};
+    Bounds bounds{glm::vec3(0.0f), glm::vec3(0.0f)};
+    bool resident{false};
+};
+
+// Drawable for a streamed mesh, draws the placeholder with its own transform until the mesh is resident.
+// The placeholder is shared, it is moved to this model's transform for every draw.
+class StreamedModel : public Drawable
+{
+private:
+    std::shared_ptr<StreamedMesh> streamed;
+    Drawable *placeholder;
+
+public:
+    StreamedModel(std::shared_ptr<StreamedMesh> _streamed, Drawable *_placeholder, const glm::vec3& color, const Transform& transform, const glm::mat4& view, const glm::mat4& projection)
+        : Drawable{_placeholder->get_bounds(), color, transform, view, projection}, streamed{std::move(_streamed)}, placeholder{_placeholder}
+    {
+        // Nothing of its own to delete, the buffers belong to the StreamedMesh.
+        VAO = 0;
+        VBO = 0;
+    };
+    StreamedModel(const StreamedModel&) = delete;
+    StreamedModel& operator=(const StreamedModel&) = delete;
+
+    bool is_resident() const
+    {
+        return streamed->is_resident();
+    };
+
+    void draw(Shader& shader) override
+    {
+        if (!streamed->is_resident())
+        {
+            placeholder->update_transform(transform);
+            placeholder->update_view(view);
+            placeholder->update_projection(projection);
+            placeholder->draw(shader);
+            return;
+        }
+        // Culling sees the placeholder bounds until the first resident draw.
+        bounds = streamed->get_bounds();
+        shader.use();
+        set_transform(shader);
+        streamed->draw();
+    };
+};
+
+// Loads meshes in the background and uploads them within a per frame budget. Reading and decoding run on
+// the thread pool, the render thread copies decoded meshes into a staging buffer and from there into the
+// mesh buffers with glCopyBufferSubData, at most bytes_per_frame bytes and roughly milliseconds_per_frame
+// of CPU time per update(). Staging buffers rotate over STAGING_FRAMES frames and are fenced, a frame whose
+// staging buffer is still read by the GPU skips uploading instead of stalling.
+class AssetStreamer
+{
+public:
+    using MeshSource = std::function<Mesh()>;
+
+    AssetStreamer(size_t _bytes_per_frame, double _milliseconds_per_frame) : bytes_per_frame{_bytes_per_frame}, milliseconds_per_frame{_milliseconds_per_frame} {};
+    AssetStreamer(const AssetStreamer &) = delete;
+    AssetStreamer &operator=(const AssetStreamer &) = delete;
+
+    ~AssetStreamer()
+    {
+        for (auto &staging : staging_buffers)
+        {
+            glDeleteBuffers(1, &staging.buffer);
+            if (staging.fence != nullptr)
+            {
+                glDeleteSync(staging.fence);
+            }
+        }
+    };
+
+    // Must be called with a current context.
+    void init()
+    {
+        for (auto &staging : staging_buffers)
+        {
+            glGenBuffers(1, &staging.buffer);
+            glBindBuffer(GL_COPY_READ_BUFFER, staging.buffer);
+            glBufferData(GL_COPY_READ_BUFFER, bytes_per_frame, nullptr, GL_STREAM_DRAW);
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    };
+
+    // The source runs on a worker thread. Dropping every other reference to the result cancels the upload.
+    std::shared_ptr<StreamedMesh> request(MeshSource source)
+    {
+        auto target = std::make_shared<StreamedMesh>();
+        in_flight++;
+        auto job = [queue = decoded, target, source = std::move(source)]
+        {
+            Upload upload{target, {}, 0, 0, false};
+            try
+            {
+                upload.mesh = source();
+            }
+            catch (const std::exception &e)
+            {
+                // The placeholder stays in place, the failed upload still leaves the queue so counts settle.
+                Logger::get().error("Streaming failed: {}", e.what());
+                upload.target.reset();
+            }
+            std::lock_guard<std::mutex> lock{queue->mutex};
+            queue->uploads.push_back(std::move(upload));
+        };
+        // Without workers the pool would never run the job, load synchronously instead.
+        if (ThreadPool::get().thread_count() == 0)
+        {
+            job();
+        }
+        else
+        {
+            ThreadPool::get().submit(std::move(job));
+        }
+        return target;
+    };
+
+    std::shared_ptr<StreamedMesh> request(const std::filesystem::path &path, const glm::vec3 &color)
+    {
+        return request([path, color] { return load_mesh(path, color); });
+    };
+
+    // Meshes requested and not resident yet.
+    uint32_t pending_count() const { return in_flight; };
+
+    // Uploads within the budget, called once per frame on the render thread.
+    void update()
+    {
+        PROFILE_FUNCTION();
+        {
+            std::lock_guard<std::mutex> lock{decoded->mutex};
+            for (auto &upload : decoded->uploads)
+            {
+                uploads.push_back(std::move(upload));
+            }
+            decoded->uploads.clear();
+        }
+        if (uploads.empty())
+        {
+            return;
+        }
+
+        Staging &staging = staging_buffers[frame % STAGING_FRAMES];
+        frame++;
+        if (staging.fence != nullptr)
+        {
+            if (glClientWaitSync(staging.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            {
+                return;
+            }
+            glDeleteSync(staging.fence);
+            staging.fence = nullptr;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        auto out_of_time = [this, start]
+        {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() >= milliseconds_per_frame;
+        };
+
+        glBindBuffer(GL_COPY_READ_BUFFER, staging.buffer);
+        // Unsynchronized is safe, the fence above proved the GPU is done with this buffer.
+        auto *mapped = static_cast<uint8_t *>(glMapBufferRange(GL_COPY_READ_BUFFER, 0, bytes_per_frame, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+        if (mapped == nullptr)
+        {
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            return;
+        }
+        size_t used{0};
+        FrameVector<Copy> copies{FrameArena::get().allocator<Copy>()};
+        FrameVector<std::shared_ptr<StreamedMesh>> completed{FrameArena::get().allocator<std::shared_ptr<StreamedMesh>>()};
+        while (!uploads.empty() && used < bytes_per_frame && !out_of_time())
+        {
+            Upload &upload = uploads.front();
+            if (upload.target == nullptr || upload.target.use_count() == 1)
+            {
+                uploads.pop_front();
+                in_flight--;
+                continue;
+            }
+            if (!upload.allocated)
+            {
+                allocate(upload);
+            }
+            const size_t vertex_bytes = upload.mesh.vertices.size() * sizeof(Vertex);
+            const size_t index_bytes = upload.mesh.indices.size() * sizeof(int32_t);
+            bool vertices_done = upload.vertex_bytes_done == vertex_bytes;
+            const uint8_t *source = vertices_done ? reinterpret_cast<const uint8_t *>(upload.mesh.indices.data()) : reinterpret_cast<const uint8_t *>(upload.mesh.vertices.data());
+            size_t &done = vertices_done ? upload.index_bytes_done : upload.vertex_bytes_done;
+            size_t total = vertices_done ? index_bytes : vertex_bytes;
+
+            size_t size = std::min({total - done, bytes_per_frame - used, SLICE_SIZE});
+            std::memcpy(mapped + used, source + done, size);
+            copies.push_back(Copy{vertices_done ? upload.target->EBO : upload.target->VBO, used, done, size});
+            used += size;
+            done += size;
+
+            if (upload.vertex_bytes_done == vertex_bytes && upload.index_bytes_done == index_bytes)
+            {
+                completed.push_back(upload.target);
+                uploads.pop_front();
+            }
+        }
+        glUnmapBuffer(GL_COPY_READ_BUFFER);
+
+        for (const auto &copy : copies)
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, copy.buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, copy.source_offset, copy.destination_offset, copy.size);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        if (!copies.empty())
+        {
+            staging.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+        // Later draws are ordered after the copies, so the meshes can be used this frame.
+        for (auto &target : completed)
+        {
+            target->resident = true;
+            in_flight--;
+        }
+    };
+
+private:
+    static constexpr uint32_t STAGING_FRAMES{3};
+    // Largest single copy, keeps the time budget checks frequent.
+    static constexpr size_t SLICE_SIZE{256 * 1024};
+
+    struct Upload
+    {
+        std::shared_ptr<StreamedMesh> target;
+        Mesh mesh;
+        size_t vertex_bytes_done;
+        size_t index_bytes_done;
+        bool allocated;
+    };
+
+    // Shared with the worker jobs, so a job finishing after the streamer is gone has somewhere to go.
+    struct DecodedQueue
+    {
+        std::mutex mutex;
+        std::vector<Upload> uploads;
+    };
+
+    struct Staging
+    {
+        uint32_t buffer{0};
+        GLsync fence{nullptr};
+    };
+
+    struct Copy
+    {
+        uint32_t buffer;
+        size_t source_offset;
+        size_t destination_offset;
+        size_t size;
+    };
+
+    size_t bytes_per_frame;
+    double milliseconds_per_frame;
+    Staging staging_buffers[STAGING_FRAMES];
+    uint64_t frame{0};
+    uint32_t in_flight{0};
+    std::shared_ptr<DecodedQueue> decoded{std::make_shared<DecodedQueue>()};
+    std::deque<Upload> uploads;
+
+    // Creates the buffers at their final size, the contents arrive through the staging copies.
+    static void allocate(Upload &upload)
+    {
+        StreamedMesh &target = *upload.target;
+        target.index_count = static_cast<uint32_t>(upload.mesh.indices.size());
+        target.bounds = get_mesh_bounds(upload.mesh);
+
+        glGenVertexArrays(1, &target.VAO);
+        glBindVertexArray(target.VAO);
+
+        glGenBuffers(1, &target.VBO);
+        glBindBuffer(GL_ARRAY_BUFFER, target.VBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * upload.mesh.vertices.size(), nullptr, GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 6, (void *)(0));
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 6, (void *)(sizeof(float) * 3));
+        glEnableVertexAttribArray(1);
+
+        glGenBuffers(1, &target.EBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, target.EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(int32_t) * upload.mesh.indices.size(), nullptr, GL_STATIC_DRAW);
+
+        // Unbound so later buffer bindings do not end up in this VAO.
+        glBindVertexArray(0);
+        upload.allocated = true;
+    };
+};
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef ATOMIC_FILE_HPP
+#define ATOMIC_FILE_HPP
+
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <ostream>
+
+// Writes path through write(std::ostream &) into a temporary file next to it and renames that over path,
+// so a crash never leaves a truncated file behind. Missing parent directories are created. Returns false
+// and removes the temporary file if anything fails, path is then left as it was.
+template <typename Writer>
+bool write_file_atomically(const std::filesystem::path &path, Writer &&write)
+{
+    std::error_code error;
+    if (path.has_parent_path())
+    {
+        std::filesystem::create_directories(path.parent_path(), error);
+    }
+    std::filesystem::path temporary_path = path;
+    temporary_path += ".tmp";
+    bool written{false};
+    {
+        std::ofstream file{temporary_path, std::ios::binary | std::ios::trunc};
+        if (file)
+        {
+            write(static_cast<std::ostream &>(file));
+            file.flush();
+            written = static_cast<bool>(file);
+        }
+    }
+    if (written)
+    {
+        std::filesystem::rename(temporary_path, path, error);
+        written = !error;
+    }
+    if (!written)
+    {
+        std::filesystem::remove(temporary_path, error);
+    }
+    return written;
+}
+
+inline bool write_file_atomically(const std::filesystem::path &path, const void *data, size_t size)
+{
+    return write_file_atomically(path, [data, size](std::ostream &file)
+    {
+        file.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+    });
+}
+
+#endif
@@ -0,0 +1,321 @@
+#ifndef CLUSTERED_LIGHTING_HPP
+#define CLUSTERED_LIGHTING_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CLUSTERED_LIGHTING_SSE 1
+#endif
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "profiler.hpp"
+#include "shader.hpp"
+#include "shader_preprocessor.hpp"
+#include "thread_pool.hpp"
+
+struct PointLight
+{
+    glm::vec3 position;
+    float radius;
+    glm::vec3 color;
+    float intensity;
+};
+
+// Splits the view frustum into TILES_X * TILES_Y screen tiles and DEPTH_SLICES exponential depth slices.
+// Every frame lights are binned into the clusters their bounding sphere touches and the per-cluster light
+// lists are uploaded to texture buffers read by frag_shader.frag built with CLUSTERED=1.
+class ClusteredLighting
+{
+public:
+    static constexpr uint32_t TILES_X{16};
+    static constexpr uint32_t TILES_Y{9};
+    static constexpr uint32_t DEPTH_SLICES{24};
+    static constexpr uint32_t TILES_PER_SLICE{TILES_X * TILES_Y};
+    static constexpr uint32_t CLUSTER_COUNT{TILES_PER_SLICE * DEPTH_SLICES};
+    static constexpr uint32_t MAX_LIGHTS_PER_CLUSTER{128};
+
+    // Texture units used by the buffers, they must not collide with material textures.
+    static constexpr int32_t GRID_UNIT{4};
+    static constexpr int32_t INDEX_UNIT{5};
+    static constexpr int32_t LIGHT_UNIT{6};
+
+    ClusteredLighting() = default;
+    ClusteredLighting(const ClusteredLighting &) = delete;
+    ClusteredLighting &operator=(const ClusteredLighting &) = delete;
+
+    ~ClusteredLighting()
+    {
+        glDeleteTextures(3, textures);
+        glDeleteBuffers(3, buffers);
+    };
+
+    void init()
+    {
+        glGenBuffers(3, buffers);
+        glGenTextures(3, textures);
+        const GLenum formats[3]{GL_RG32UI, GL_R32UI, GL_RGBA32F};
+        for (int i = 0; i < 3; i++)
+        {
+            glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+            glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+            glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+            glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+        }
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    };
+
+    // Recomputes the view space cluster bounds, call when the projection changes.
+    void set_projection(const glm::mat4 &projection, float _z_near, float _z_far)
+    {
+        z_near = _z_near;
+        z_far = _z_far;
+        glm::mat4 inverse_projection = glm::inverse(projection);
+        auto unproject = [&](float x, float y)
+        {
+            glm::vec4 point = inverse_projection * glm::vec4(x, y, -1.0f, 1.0f);
+            return glm::vec3(point) / point.w;
+        };
+
+        for (uint32_t z = 0; z < DEPTH_SLICES; z++)
+        {
+            float slice_near = slice_depth(z);
+            float slice_far = slice_depth(z + 1);
+            SliceBounds &slice = slices[z];
+            for (uint32_t y = 0; y < TILES_Y; y++)
+            {
+                for (uint32_t x = 0; x < TILES_X; x++)
+                {
+                    glm::vec3 low = unproject(-1.0f + 2.0f * x / TILES_X, -1.0f + 2.0f * y / TILES_Y);
+                    glm::vec3 high = unproject(-1.0f + 2.0f * (x + 1) / TILES_X, -1.0f + 2.0f * (y + 1) / TILES_Y);
+                    // Points on the near plane scaled along their view rays onto both slice planes.
+                    glm::vec3 corners[4]{low * (slice_near / -low.z), high * (slice_near / -high.z), low * (slice_far / -low.z), high * (slice_far / -high.z)};
+                    glm::vec3 minimum = corners[0];
+                    glm::vec3 maximum = corners[0];
+                    for (const auto &corner : corners)
+                    {
+                        minimum = glm::min(minimum, corner);
+                        maximum = glm::max(maximum, corner);
+                    }
+                    uint32_t tile = y * TILES_X + x;
+                    slice.min_x[tile] = minimum.x;
+                    slice.min_y[tile] = minimum.y;
+                    slice.min_z[tile] = minimum.z;
+                    slice.max_x[tile] = maximum.x;
+                    slice.max_y[tile] = maximum.y;
+                    slice.max_z[tile] = maximum.z;
+                }
+            }
+        }
+    };
+
+    // Defines a program needs to read the clusters, merged into the material's own defines.
+    static ShaderDefines shader_defines(ShaderDefines defines)
+    {
+        defines["CLUSTERED"] = "1";
+        defines["CLUSTER_TILES_X"] = std::to_string(TILES_X);
+        defines["CLUSTER_TILES_Y"] = std::to_string(TILES_Y);
+        defines["CLUSTER_DEPTH_SLICES"] = std::to_string(DEPTH_SLICES);
+        return defines;
+    };
+
+    // Bins the lights on the thread pool, each worker owns a range of depth slices so no locking is needed.
+    void update(const std::vector<PointLight> &lights, const glm::mat4 &view)
+    {
+        PROFILE_FUNCTION();
+        light_count = static_cast<uint32_t>(std::min<size_t>(lights.size(), UINT16_MAX));
+        view_lights.resize(light_count);
+        for (uint32_t i = 0; i < light_count; i++)
+        {
+            glm::vec3 center = glm::vec3(view * glm::vec4(lights[i].position, 1.0f));
+            view_lights[i] = ViewLight{center, lights[i].radius, slice_index(-center.z - lights[i].radius), slice_index(-center.z + lights[i].radius)};
+        }
+
+        counts.assign(CLUSTER_COUNT, 0);
+        cluster_lights.resize(static_cast<size_t>(CLUSTER_COUNT) * MAX_LIGHTS_PER_CLUSTER);
+        ThreadPool::get().parallel_for(DEPTH_SLICES, 1, [this](size_t begin, size_t end)
+        {
+            for (size_t z = begin; z < end; z++)
+            {
+                bin_slice(static_cast<uint32_t>(z));
+            }
+        });
+
+        grid.resize(CLUSTER_COUNT * 2);
+        indices.clear();
+        for (uint32_t cluster = 0; cluster < CLUSTER_COUNT; cluster++)
+        {
+            grid[cluster * 2] = static_cast<uint32_t>(indices.size());
+            grid[cluster * 2 + 1] = counts[cluster];
+            const uint16_t *list = cluster_lights.data() + static_cast<size_t>(cluster) * MAX_LIGHTS_PER_CLUSTER;
+            indices.insert(indices.end(), list, list + counts[cluster]);
+        }
+
+        light_data.resize(static_cast<size_t>(light_count) * 2);
+        for (uint32_t i = 0; i < light_count; i++)
+        {
+            light_data[i * 2] = glm::vec4(lights[i].position, lights[i].radius);
+            light_data[i * 2 + 1] = glm::vec4(lights[i].color * lights[i].intensity, 0.0f);
+        }
+
+        upload(buffers[0], grid.data(), grid.size() * sizeof(uint32_t));
+        upload(buffers[1], indices.data(), std::max<size_t>(indices.size(), 1) * sizeof(uint32_t));
+        upload(buffers[2], light_data.data(), std::max<size_t>(light_data.size(), 1) * sizeof(glm::vec4));
+    };
+
+    // Binds the buffers and sets the uniforms of a program built with CLUSTERED=1.
+    void bind(Shader &shader, int32_t width, int32_t height) const
+    {
+        const int32_t units[3]{GRID_UNIT, INDEX_UNIT, LIGHT_UNIT};
+        for (int i = 0; i < 3; i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + units[i]);
+            glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+        }
+        glActiveTexture(GL_TEXTURE0);
+
+        float log_ratio = std::log(z_far / z_near);
+        shader.set_int("cluster_grid", GRID_UNIT);
+        shader.set_int("cluster_light_indices", INDEX_UNIT);
+        shader.set_int("cluster_lights", LIGHT_UNIT);
+        shader.set_vec2("cluster_tile_size", width / static_cast<float>(TILES_X), height / static_cast<float>(TILES_Y));
+        shader.set_vec2("cluster_depth_range", z_near, z_far);
+        shader.set_vec2("cluster_slice_transform", DEPTH_SLICES / log_ratio, -DEPTH_SLICES * std::log(z_near) / log_ratio);
+    };
+
+    // Total light references over all clusters after the last update, useful to tune light radii.
+    size_t reference_count() const { return indices.size(); };
+
+private:
+    struct ViewLight
+    {
+        glm::vec3 center;
+        float radius;
+        uint32_t first_slice;
+        uint32_t last_slice;
+    };
+
+    // Structure of arrays so four tiles are tested at once.
+    struct SliceBounds
+    {
+        alignas(16) float min_x[TILES_PER_SLICE];
+        alignas(16) float min_y[TILES_PER_SLICE];
+        alignas(16) float min_z[TILES_PER_SLICE];
+        alignas(16) float max_x[TILES_PER_SLICE];
+        alignas(16) float max_y[TILES_PER_SLICE];
+        alignas(16) float max_z[TILES_PER_SLICE];
+    };
+    static_assert(TILES_PER_SLICE % 4 == 0, "Tiles per slice must be a multiple of the SIMD width.");
+
+    uint32_t buffers[3]{};
+    uint32_t textures[3]{};
+    float z_near{0.1f};
+    float z_far{100.0f};
+
+    std::vector<SliceBounds> slices = std::vector<SliceBounds>(DEPTH_SLICES);
+    std::vector<ViewLight> view_lights;
+    uint32_t light_count{0};
+    std::vector<uint32_t> counts;
+    std::vector<uint16_t> cluster_lights;
+    std::vector<uint32_t> grid;
+    std::vector<uint32_t> indices;
+    std::vector<glm::vec4> light_data;
+
+    float slice_depth(uint32_t slice) const
+    {
+        return z_near * std::pow(z_far / z_near, slice / static_cast<float>(DEPTH_SLICES));
+    };
+
+    uint32_t slice_index(float depth) const
+    {
+        if (depth <= z_near)
+        {
+            return 0;
+        }
+        float slice = std::floor(std::log(depth / z_near) / std::log(z_far / z_near) * DEPTH_SLICES);
+        return static_cast<uint32_t>(std::clamp(slice, 0.0f, static_cast<float>(DEPTH_SLICES - 1)));
+    };
+
+    void bin_slice(uint32_t z)
+    {
+        const SliceBounds &slice = slices[z];
+        uint32_t first_cluster = z * TILES_PER_SLICE;
+        for (uint32_t light = 0; light < light_count; light++)
+        {
+            const ViewLight &view_light = view_lights[light];
+            if (z < view_light.first_slice || z > view_light.last_slice)
+            {
+                continue;
+            }
+            for (uint32_t tile = 0; tile < TILES_PER_SLICE; tile += 4)
+            {
+                uint32_t mask = sphere_overlaps_tiles(slice, tile, view_light.center, view_light.radius);
+                while (mask != 0)
+                {
+                    uint32_t cluster = first_cluster + tile + lowest_bit(mask);
+                    mask &= mask - 1;
+                    if (counts[cluster] < MAX_LIGHTS_PER_CLUSTER)
+                    {
+                        cluster_lights[static_cast<size_t>(cluster) * MAX_LIGHTS_PER_CLUSTER + counts[cluster]++] = static_cast<uint16_t>(light);
+                    }
+                }
+            }
+        }
+    };
+
+    static uint32_t lowest_bit(uint32_t mask)
+    {
+        uint32_t index{0};
+        while ((mask & 1u) == 0)
+        {
+            mask >>= 1;
+            index++;
+        }
+        return index;
+    };
+
+    // Sphere against four cluster boxes starting at tile, returns one bit per overlapping box.
+    static uint32_t sphere_overlaps_tiles(const SliceBounds &slice, uint32_t tile, const glm::vec3 &center, float radius)
+    {
+#ifdef CLUSTERED_LIGHTING_SSE
+        const __m128 zero = _mm_setzero_ps();
+        auto axis_distance = [&](const float *minimum, const float *maximum, float value)
+        {
+            __m128 point = _mm_set1_ps(value);
+            __m128 below = _mm_max_ps(_mm_sub_ps(_mm_load_ps(minimum + tile), point), zero);
+            __m128 above = _mm_max_ps(_mm_sub_ps(point, _mm_load_ps(maximum + tile)), zero);
+            __m128 distance = _mm_add_ps(below, above);
+            return _mm_mul_ps(distance, distance);
+        };
+        __m128 distance = _mm_add_ps(_mm_add_ps(axis_distance(slice.min_x, slice.max_x, center.x), axis_distance(slice.min_y, slice.max_y, center.y)), axis_distance(slice.min_z, slice.max_z, center.z));
+        return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(distance, _mm_set1_ps(radius * radius))));
+#else
+        uint32_t mask{0};
+        for (uint32_t i = 0; i < 4; i++)
+        {
+            uint32_t index = tile + i;
+            float distance{0.0f};
+            distance += std::pow(std::max(slice.min_x[index] - center.x, 0.0f) + std::max(center.x - slice.max_x[index], 0.0f), 2.0f);
+            distance += std::pow(std::max(slice.min_y[index] - center.y, 0.0f) + std::max(center.y - slice.max_y[index], 0.0f), 2.0f);
+            distance += std::pow(std::max(slice.min_z[index] - center.z, 0.0f) + std::max(center.z - slice.max_z[index], 0.0f), 2.0f);
+            mask |= distance <= radius * radius ? 1u << i : 0u;
+        }
+        return mask;
+#endif
+    };
+
+    static void upload(uint32_t buffer, const void *data, size_t size)
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, static_cast<GLsizeiptr>(size), data, GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    };
+};
+
+#endif
@@ -0,0 +1,181 @@
+#ifndef DEFERRED_SHADING_HPP
+#define DEFERRED_SHADING_HPP
+
+#include <cstdint>
+#include <stdexcept>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "shader.hpp"
+
+// G-buffer for the deferred path: world space normal, albedo and depth. The geometry pass writes it once,
+// the lighting passes read it back per pixel so lighting cost depends on covered pixels rather than on
+// scene geometry and overdraw.
+class DeferredShading
+{
+public:
+    // Texture units the G-buffer is bound to while lighting, see gbuffer.glsl.
+    static constexpr int32_t NORMAL_UNIT{0};
+    static constexpr int32_t ALBEDO_UNIT{1};
+    static constexpr int32_t DEPTH_UNIT{2};
+
+    DeferredShading() = default;
+    DeferredShading(const DeferredShading &) = delete;
+    DeferredShading &operator=(const DeferredShading &) = delete;
+
+    ~DeferredShading()
+    {
+        release();
+        glDeleteVertexArrays(1, &fullscreen_vao);
+    };
+
+    void init(int32_t _width, int32_t _height)
+    {
+        // Core profile needs a bound VAO even though fullscreen.vert builds its vertices from gl_VertexID.
+        glGenVertexArrays(1, &fullscreen_vao);
+        resize(_width, _height);
+    };
+
+    void resize(int32_t _width, int32_t _height)
+    {
+        // Minimized windows report a zero size, keep the old buffers until there is something to draw.
+        if (_width <= 0 || _height <= 0)
+        {
+            return;
+        }
+        release();
+        width = _width;
+        height = _height;
+
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        normal_texture = create_texture(GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT);
+        albedo_texture = create_texture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+        // Same format as the default framebuffer depth so it can be blitted for the forward passes after lighting.
+        depth_texture = create_texture(GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, normal_texture, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, albedo_texture, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depth_texture, 0);
+        const GLenum attachments[2]{GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+        glDrawBuffers(2, attachments);
+
+        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (status != GL_FRAMEBUFFER_COMPLETE)
+        {
+            throw std::runtime_error("G-buffer framebuffer is incomplete.");
+        }
+    };
+
+    void begin_geometry_pass()
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    };
+
+    void end_geometry_pass()
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    };
+
+    // Lighting passes write the bound framebuffer without touching its depth. The first full screen pass
+    // replaces the color of the covered pixels, so the clear color only remains where it discards.
+    void begin_lighting_pass()
+    {
+        glDisable(GL_DEPTH_TEST);
+        glDepthMask(GL_FALSE);
+        glDisable(GL_BLEND);
+    };
+
+    void end_lighting_pass()
+    {
+        glDisable(GL_CULL_FACE);
+        glDisable(GL_BLEND);
+        glDepthMask(GL_TRUE);
+        glEnable(GL_DEPTH_TEST);
+    };
+
+    // Binds the G-buffer textures and the uniforms gbuffer.glsl needs to rebuild world positions.
+    void bind(Shader &shader, const glm::mat4 &view, const glm::mat4 &projection) const
+    {
+        glActiveTexture(GL_TEXTURE0 + NORMAL_UNIT);
+        glBindTexture(GL_TEXTURE_2D, normal_texture);
+        glActiveTexture(GL_TEXTURE0 + ALBEDO_UNIT);
+        glBindTexture(GL_TEXTURE_2D, albedo_texture);
+        glActiveTexture(GL_TEXTURE0 + DEPTH_UNIT);
+        glBindTexture(GL_TEXTURE_2D, depth_texture);
+        glActiveTexture(GL_TEXTURE0);
+
+        shader.use();
+        shader.set_int("gbuffer_normal", NORMAL_UNIT);
+        shader.set_int("gbuffer_albedo", ALBEDO_UNIT);
+        shader.set_int("gbuffer_depth", DEPTH_UNIT);
+        shader.set_mat4("inverse_view_projection", glm::inverse(projection * view));
+        shader.set_vec2("viewport_size", static_cast<float>(width), static_cast<float>(height));
+    };
+
+    // Full screen triangle for passes that touch every pixel, such as ambient and unbounded lights.
+    void draw_fullscreen() const
+    {
+        glBindVertexArray(fullscreen_vao);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    };
+
+    // Light volumes add up on top of the full screen pass. They draw only their back faces with depth
+    // testing off, so each covered pixel is lit exactly once, also when the camera is inside the volume.
+    void begin_light_volumes()
+    {
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+        glEnable(GL_CULL_FACE);
+        glCullFace(GL_FRONT);
+    };
+
+    // Copies the G-buffer depth into the default framebuffer so forward passes after lighting depth test
+    // against the deferred geometry.
+    void blit_depth() const
+    {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    };
+
+private:
+    int32_t width{0};
+    int32_t height{0};
+    uint32_t framebuffer{0};
+    uint32_t normal_texture{0};
+    uint32_t albedo_texture{0};
+    uint32_t depth_texture{0};
+    uint32_t fullscreen_vao{0};
+
+    uint32_t create_texture(GLenum internal_format, GLenum format, GLenum type) const
+    {
+        uint32_t texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, format, type, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return texture;
+    };
+
+    void release()
+    {
+        if (framebuffer != 0)
+        {
+            glDeleteFramebuffers(1, &framebuffer);
+            const uint32_t textures[3]{normal_texture, albedo_texture, depth_texture};
+            glDeleteTextures(3, textures);
+            framebuffer = 0;
+        }
+    };
+};
+
+#endif
@@ -0,0 +1,191 @@
+#ifndef FRAME_ARENA_HPP
+#define FRAME_ARENA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+// Bump allocator over one block, everything is freed at once by reset(). Allocations that do not fit go
+// to separate heap blocks until the next reset(), which then grows the block so the same demand fits.
+class LinearArena
+{
+public:
+    explicit LinearArena(size_t _capacity) : block{std::make_unique<std::byte[]>(_capacity)}, capacity{_capacity} {};
+
+    void *allocate(size_t size, size_t alignment)
+    {
+        std::byte *base = block.get();
+        size_t offset = align(reinterpret_cast<uintptr_t>(base) + used, alignment) - reinterpret_cast<uintptr_t>(base);
+        if (offset <= capacity && size <= capacity - offset)
+        {
+            used = offset + size;
+            return base + offset;
+        }
+        overflow_bytes += size + alignment;
+        overflow.push_back(std::make_unique<std::byte[]>(size + alignment));
+        return reinterpret_cast<void *>(align(reinterpret_cast<uintptr_t>(overflow.back().get()), alignment));
+    };
+
+    // Only the latest allocation is given back, so containers freed in reverse order of creation return their space.
+    void deallocate(void *pointer, size_t size)
+    {
+        std::byte *end = block.get() + used;
+        if (static_cast<std::byte *>(pointer) + size == end)
+        {
+            used -= size;
+        }
+    };
+
+    void reset()
+    {
+        if (overflow_bytes > 0)
+        {
+            capacity += overflow_bytes + overflow_bytes / 2;
+            block = std::make_unique<std::byte[]>(capacity);
+            overflow.clear();
+            overflow_bytes = 0;
+        }
+        used = 0;
+    };
+
+    size_t used_bytes() const { return used + overflow_bytes; };
+    size_t capacity_bytes() const { return capacity; };
+
+private:
+    std::unique_ptr<std::byte[]> block;
+    size_t capacity;
+    size_t used{0};
+    size_t overflow_bytes{0};
+    std::vector<std::unique_ptr<std::byte[]>> overflow;
+
+    static uintptr_t align(uintptr_t address, size_t alignment)
+    {
+        return (address + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+    };
+};
+
+// Standard allocator over a LinearArena, deallocation is (almost) free and the memory only comes back
+// when the arena is reset.
+template <typename T>
+class ArenaAllocator
+{
+public:
+    using value_type = T;
+    using propagate_on_container_move_assignment = std::true_type;
+
+    explicit ArenaAllocator(LinearArena &_arena) : arena{&_arena} {};
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena{other.arena} {};
+
+    T *allocate(size_t count)
+    {
+        if (count > std::numeric_limits<size_t>::max() / sizeof(T))
+        {
+            throw std::bad_array_new_length();
+        }
+        return static_cast<T *>(arena->allocate(count * sizeof(T), alignof(T)));
+    };
+
+    void deallocate(T *pointer, size_t count)
+    {
+        arena->deallocate(pointer, count * sizeof(T));
+    };
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U> &other) const { return arena == other.arena; };
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U> &other) const { return arena != other.arena; };
+
+private:
+    template <typename U>
+    friend class ArenaAllocator;
+
+    LinearArena *arena;
+};
+
+template <typename T>
+using FrameVector = std::vector<T, ArenaAllocator<T>>;
+
+// Transient memory of the render path. Every frame in flight has one arena per thread of the thread pool,
+// begin_frame() moves on to the oldest frame and resets its arenas, so data built in a frame stays valid
+// for FRAMES_IN_FLIGHT - 1 more frames. Only the main thread and parallel_for bodies may allocate from it,
+// and begin_frame() must not run while they do. Background tasks keep using the heap.
+class FrameArena
+{
+public:
+    static constexpr uint32_t FRAMES_IN_FLIGHT{2};
+    static constexpr size_t INITIAL_CAPACITY{1 << 20};
+
+    static FrameArena &get()
+    {
+        static FrameArena frame_arena;
+        return frame_arena;
+    };
+
+    FrameArena(const FrameArena &) = delete;
+    FrameArena &operator=(const FrameArena &) = delete;
+
+    void begin_frame()
+    {
+        frame = (frame + 1) % FRAMES_IN_FLIGHT;
+        for (auto &arena : arenas[frame])
+        {
+            arena.reset();
+        }
+    };
+
+    // The calling thread's arena of the current frame.
+    LinearArena &arena() { return arenas[frame][ThreadPool::thread_index()]; };
+
+    template <typename T>
+    ArenaAllocator<T> allocator() { return ArenaAllocator<T>{arena()}; };
+
+    // Bytes allocated so far in the current frame, over all threads.
+    size_t used_bytes() const
+    {
+        size_t used{0};
+        for (const auto &arena : arenas[frame])
+        {
+            used += arena.used_bytes();
+        }
+        return used;
+    };
+
+    size_t capacity_bytes() const
+    {
+        size_t capacity{0};
+        for (const auto &frame_arenas : arenas)
+        {
+            for (const auto &arena : frame_arenas)
+            {
+                capacity += arena.capacity_bytes();
+            }
+        }
+        return capacity;
+    };
+
+private:
+    std::vector<LinearArena> arenas[FRAMES_IN_FLIGHT];
+    uint32_t frame{0};
+
+    FrameArena()
+    {
+        size_t thread_count = ThreadPool::get().thread_count() + 1;
+        for (auto &frame_arenas : arenas)
+        {
+            frame_arenas.reserve(thread_count);
+            for (size_t i = 0; i < thread_count; i++)
+            {
+                frame_arenas.emplace_back(INITIAL_CAPACITY);
+            }
+        }
+    };
+};
+
+#endif
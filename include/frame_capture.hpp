@@ -0,0 +1,297 @@
+#ifndef FRAME_CAPTURE_HPP
+#define FRAME_CAPTURE_HPP
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "logger.hpp"
+#include "profiler.hpp"
+
+// Reads the back buffer into a ring of pixel buffer objects. A slot is mapped only after its fence has
+// signaled, a few frames later, and the pixels are written to disk by a worker thread.
+class FrameCapture
+{
+public:
+    static constexpr size_t RING_SIZE{3};
+    static constexpr size_t MAX_PENDING_WRITES{8};
+
+    FrameCapture() = default;
+    FrameCapture(const FrameCapture &) = delete;
+    FrameCapture &operator=(const FrameCapture &) = delete;
+
+    ~FrameCapture()
+    {
+        stop();
+        {
+            std::lock_guard<std::mutex> lock{jobs_mutex};
+            stopping = true;
+        }
+        jobs_condition.notify_one();
+        if (worker.joinable())
+        {
+            worker.join();
+        }
+    };
+
+    bool is_active() const { return active; };
+    uint64_t dropped_count() const { return dropped; };
+
+    // Starts capturing every frame into directory/frame_<n>.ppm.
+    void start(const std::string &_directory, int32_t _width, int32_t _height)
+    {
+        if (active)
+        {
+            return;
+        }
+        std::error_code error;
+        std::filesystem::create_directories(_directory, error);
+        if (error)
+        {
+            Logger::get().error("Failed to create capture directory {}", _directory);
+            return;
+        }
+        if (!worker.joinable())
+        {
+            worker = std::thread{&FrameCapture::worker_loop, this};
+        }
+        directory = _directory;
+        create_buffers(_width, _height);
+        active = true;
+        Logger::get().info("Frame capture started, writing to {}", directory);
+    };
+
+    void stop()
+    {
+        if (!active)
+        {
+            return;
+        }
+        for (auto &slot : slots)
+        {
+            if (slot.fence != nullptr)
+            {
+                glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+                read_slot(slot);
+            }
+        }
+        delete_buffers();
+        active = false;
+        Logger::get().info("Frame capture stopped, {} frames dropped", dropped);
+    };
+
+    void resize(int32_t _width, int32_t _height)
+    {
+        if (!active)
+        {
+            return;
+        }
+        stop();
+        start(directory, _width, _height);
+    };
+
+    // Call after the frame is rendered and before the buffers are swapped.
+    void capture()
+    {
+        if (!active)
+        {
+            return;
+        }
+        PROFILE_FUNCTION();
+        poll();
+
+        Slot &slot = slots[next_slot];
+        if (slot.fence != nullptr)
+        {
+            // The oldest readback has still not finished, skip this frame instead of stalling.
+            dropped++;
+            frame_number++;
+            return;
+        }
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot.frame = frame_number++;
+        next_slot = (next_slot + 1) % RING_SIZE;
+    };
+
+private:
+    struct Slot
+    {
+        uint32_t pbo{0};
+        GLsync fence{nullptr};
+        uint64_t frame{0};
+    };
+
+    struct Job
+    {
+        std::string path;
+        int32_t width;
+        int32_t height;
+        std::vector<uint8_t> pixels;
+    };
+
+    std::array<Slot, RING_SIZE> slots;
+    size_t next_slot{0};
+    int32_t width{0};
+    int32_t height{0};
+    bool active{false};
+    uint64_t frame_number{0};
+    uint64_t dropped{0};
+    std::string directory;
+
+    std::mutex jobs_mutex;
+    std::condition_variable jobs_condition;
+    std::deque<Job> jobs;
+    std::vector<std::vector<uint8_t>> free_pixels;
+    bool stopping{false};
+    std::thread worker;
+
+    void create_buffers(int32_t _width, int32_t _height)
+    {
+        width = _width;
+        height = _height;
+        for (auto &slot : slots)
+        {
+            glGenBuffers(1, &slot.pbo);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+            glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(width) * height * 4, nullptr, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        next_slot = 0;
+    };
+
+    void delete_buffers()
+    {
+        for (auto &slot : slots)
+        {
+            glDeleteBuffers(1, &slot.pbo);
+            slot = Slot{};
+        }
+    };
+
+    // Hands every slot whose fence has signaled to the writer, never waits.
+    void poll()
+    {
+        for (size_t i = 0; i < RING_SIZE; i++)
+        {
+            Slot &slot = slots[(next_slot + i) % RING_SIZE];
+            if (slot.fence == nullptr)
+            {
+                continue;
+            }
+            GLenum status = glClientWaitSync(slot.fence, 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            {
+                continue;
+            }
+            read_slot(slot);
+        }
+    };
+
+    void read_slot(Slot &slot)
+    {
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+
+        size_t size = static_cast<size_t>(width) * height * 4;
+        Job job{directory + "/frame_" + std::to_string(slot.frame) + ".ppm", width, height, {}};
+        {
+            std::lock_guard<std::mutex> lock{jobs_mutex};
+            if (jobs.size() >= MAX_PENDING_WRITES)
+            {
+                dropped++;
+                return;
+            }
+            if (!free_pixels.empty())
+            {
+                job.pixels = std::move(free_pixels.back());
+                free_pixels.pop_back();
+            }
+        }
+        job.pixels.resize(size);
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        const void *data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(size), GL_MAP_READ_BIT);
+        if (data != nullptr)
+        {
+            std::memcpy(job.pixels.data(), data, size);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        if (data == nullptr)
+        {
+            dropped++;
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock{jobs_mutex};
+            jobs.push_back(std::move(job));
+        }
+        jobs_condition.notify_one();
+    };
+
+    void worker_loop()
+    {
+        std::vector<uint8_t> row;
+        while (true)
+        {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock{jobs_mutex};
+                jobs_condition.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (jobs.empty())
+                {
+                    return;
+                }
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+
+            write_ppm(job, row);
+
+            std::lock_guard<std::mutex> lock{jobs_mutex};
+            free_pixels.push_back(std::move(job.pixels));
+        }
+    };
+
+    // OpenGL rows start at the bottom, PPM rows at the top.
+    static void write_ppm(const Job &job, std::vector<uint8_t> &row)
+    {
+        std::FILE *file = std::fopen(job.path.c_str(), "wb");
+        if (file == nullptr)
+        {
+            Logger::get().error("Failed to open {}", job.path);
+            return;
+        }
+        std::fprintf(file, "P6\n%d %d\n255\n", job.width, job.height);
+        row.resize(static_cast<size_t>(job.width) * 3);
+        for (int32_t y = job.height - 1; y >= 0; y--)
+        {
+            const uint8_t *source = job.pixels.data() + static_cast<size_t>(y) * job.width * 4;
+            for (int32_t x = 0; x < job.width; x++)
+            {
+                row[x * 3 + 0] = source[x * 4 + 0];
+                row[x * 3 + 1] = source[x * 4 + 1];
+                row[x * 3 + 2] = source[x * 4 + 2];
+            }
+            std::fwrite(row.data(), 1, row.size(), file);
+        }
+        std::fclose(file);
+    };
+};
+
+#endif
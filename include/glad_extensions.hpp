@@ -0,0 +1,151 @@
+#ifndef GLAD_EXTENSIONS_HPP
+#define GLAD_EXTENSIONS_HPP
+
+#include <cstring>
+
+#include <glad/glad.h>
+
+// The bundled glad loader is generated for core 3.3 without extensions. Entry points of newer versions
+// and extensions used by the renderer are declared and loaded here in the same style, so call sites look
+// like plain GL. Every block is skipped if glad is regenerated with the corresponding version.
+
+inline bool gl_has_extension(const char *name)
+{
+    int32_t count{0};
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (int32_t i = 0; i < count; i++)
+    {
+        const char *extension = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, static_cast<uint32_t>(i)));
+        if (extension != nullptr && std::strcmp(extension, name) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool gl_version_at_least(int major, int minor)
+{
+    return GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor);
+}
+
+// GL 4.0 tessellation shaders
+#ifndef GL_VERSION_4_0
+#define GL_PATCHES 0x000E
+#define GL_PATCH_VERTICES 0x8E72
+#define GL_TESS_EVALUATION_SHADER 0x8E87
+#define GL_TESS_CONTROL_SHADER 0x8E88
+typedef void (APIENTRYP PFNGLPATCHPARAMETERIPROC)(GLenum pname, GLint value);
+inline PFNGLPATCHPARAMETERIPROC glad_glPatchParameteri{nullptr};
+#define glPatchParameteri glad_glPatchParameteri
+#endif
+
+// GL 4.1 / ARB_get_program_binary
+#ifndef GL_VERSION_4_1
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#define GL_PROGRAM_BINARY_FORMATS 0x87FF
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+inline PFNGLGETPROGRAMBINARYPROC glad_glGetProgramBinary{nullptr};
+inline PFNGLPROGRAMBINARYPROC glad_glProgramBinary{nullptr};
+inline PFNGLPROGRAMPARAMETERIPROC glad_glProgramParameteri{nullptr};
+#define glGetProgramBinary glad_glGetProgramBinary
+#define glProgramBinary glad_glProgramBinary
+#define glProgramParameteri glad_glProgramParameteri
+#endif
+
+// KHR_parallel_shader_compile / ARB_parallel_shader_compile
+#ifndef GL_KHR_parallel_shader_compile
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+inline PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glad_glMaxShaderCompilerThreadsKHR{nullptr};
+#define glMaxShaderCompilerThreadsKHR glad_glMaxShaderCompilerThreadsKHR
+#endif
+
+// GL 4.3 compute shaders, storage buffers, image load/store and indirect multi draw
+#ifndef GL_VERSION_4_3
+#define GL_COMPUTE_SHADER 0x91B9
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#define GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT 0x00000001
+#define GL_TEXTURE_FETCH_BARRIER_BIT 0x00000008
+#define GL_SHADER_IMAGE_ACCESS_BARRIER_BIT 0x00000020
+#define GL_COMMAND_BARRIER_BIT 0x00000040
+#define GL_SHADER_STORAGE_BARRIER_BIT 0x00002000
+typedef void (APIENTRYP PFNGLDISPATCHCOMPUTEPROC)(GLuint num_groups_x, GLuint num_groups_y, GLuint num_groups_z);
+typedef void (APIENTRYP PFNGLMEMORYBARRIERPROC)(GLbitfield barriers);
+typedef void (APIENTRYP PFNGLBINDIMAGETEXTUREPROC)(GLuint unit, GLuint texture, GLint level, GLboolean layered, GLint layer, GLenum access, GLenum format);
+typedef void (APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void *indirect, GLsizei drawcount, GLsizei stride);
+inline PFNGLDISPATCHCOMPUTEPROC glad_glDispatchCompute{nullptr};
+inline PFNGLMEMORYBARRIERPROC glad_glMemoryBarrier{nullptr};
+inline PFNGLBINDIMAGETEXTUREPROC glad_glBindImageTexture{nullptr};
+inline PFNGLMULTIDRAWELEMENTSINDIRECTPROC glad_glMultiDrawElementsIndirect{nullptr};
+#define glDispatchCompute glad_glDispatchCompute
+#define glMemoryBarrier glad_glMemoryBarrier
+#define glBindImageTexture glad_glBindImageTexture
+#define glMultiDrawElementsIndirect glad_glMultiDrawElementsIndirect
+#endif
+
+struct GladExtensions
+{
+    bool program_binary{false};
+    bool parallel_shader_compile{false};
+    // Tessellation control and evaluation stages, see TessellatedSphere.
+    bool tessellation{false};
+    // Everything the GPU driven path needs, see GpuDrivenScene.
+    bool gpu_driven{false};
+};
+
+inline GladExtensions GLAD_EXTENSIONS{};
+
+// Must be called after gladLoadGLLoader with the same loader.
+inline void load_glad_extensions(GLADloadproc load)
+{
+#ifndef GL_VERSION_4_0
+    if (gl_version_at_least(4, 0))
+    {
+        glad_glPatchParameteri = reinterpret_cast<PFNGLPATCHPARAMETERIPROC>(load("glPatchParameteri"));
+    }
+#endif
+    GLAD_EXTENSIONS.tessellation = gl_version_at_least(4, 0) && glPatchParameteri != nullptr;
+
+#ifndef GL_VERSION_4_1
+    if (gl_version_at_least(4, 1) || gl_has_extension("GL_ARB_get_program_binary"))
+    {
+        glad_glGetProgramBinary = reinterpret_cast<PFNGLGETPROGRAMBINARYPROC>(load("glGetProgramBinary"));
+        glad_glProgramBinary = reinterpret_cast<PFNGLPROGRAMBINARYPROC>(load("glProgramBinary"));
+        glad_glProgramParameteri = reinterpret_cast<PFNGLPROGRAMPARAMETERIPROC>(load("glProgramParameteri"));
+    }
+#endif
+    GLAD_EXTENSIONS.program_binary = glGetProgramBinary != nullptr && glProgramBinary != nullptr && glProgramParameteri != nullptr;
+
+#ifndef GL_KHR_parallel_shader_compile
+    if (gl_has_extension("GL_KHR_parallel_shader_compile"))
+    {
+        glad_glMaxShaderCompilerThreadsKHR = reinterpret_cast<PFNGLMAXSHADERCOMPILERTHREADSKHRPROC>(load("glMaxShaderCompilerThreadsKHR"));
+    }
+    else if (gl_has_extension("GL_ARB_parallel_shader_compile"))
+    {
+        glad_glMaxShaderCompilerThreadsKHR = reinterpret_cast<PFNGLMAXSHADERCOMPILERTHREADSKHRPROC>(load("glMaxShaderCompilerThreadsARB"));
+    }
+#endif
+    GLAD_EXTENSIONS.parallel_shader_compile = glMaxShaderCompilerThreadsKHR != nullptr;
+
+#ifndef GL_VERSION_4_3
+    if (gl_version_at_least(4, 3))
+    {
+        glad_glDispatchCompute = reinterpret_cast<PFNGLDISPATCHCOMPUTEPROC>(load("glDispatchCompute"));
+        glad_glMemoryBarrier = reinterpret_cast<PFNGLMEMORYBARRIERPROC>(load("glMemoryBarrier"));
+        glad_glBindImageTexture = reinterpret_cast<PFNGLBINDIMAGETEXTUREPROC>(load("glBindImageTexture"));
+        glad_glMultiDrawElementsIndirect = reinterpret_cast<PFNGLMULTIDRAWELEMENTSINDIRECTPROC>(load("glMultiDrawElementsIndirect"));
+    }
+#endif
+    GLAD_EXTENSIONS.gpu_driven = gl_version_at_least(4, 3) && glDispatchCompute != nullptr && glMemoryBarrier != nullptr &&
+                                 glBindImageTexture != nullptr && glMultiDrawElementsIndirect != nullptr;
+}
+
+#endif
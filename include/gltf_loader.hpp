@@ -0,0 +1,307 @@
+#ifndef GLTF_LOADER_HPP
+#define GLTF_LOADER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "json.hpp"
+#include "logger.hpp"
+#include "mapped_file.hpp"
+#include "mesh.hpp"
+#include "profiler.hpp"
+#include "thread_pool.hpp"
+
+// glTF 2.0 reader for .glb and .gltf files with external buffers. Buffers are mapped and accessors are
+// read straight from the mapping, so the only per vertex work is the conversion into Vertex, done in
+// parallel. All triangle primitives of all meshes are merged in mesh space, node transforms, sparse and
+// quantized accessors and embedded base64 buffers are not supported.
+class GltfLoader
+{
+public:
+    static Mesh load(const std::filesystem::path &path, const glm::vec3 &color)
+    {
+        PROFILE_FUNCTION();
+        GltfLoader loader{path};
+        Mesh mesh;
+        mesh.color = color;
+        std::vector<uint8_t> missing_normals;
+        bool any_missing{false};
+
+        for (const auto &gltf_mesh : loader.document["meshes"].items)
+        {
+            for (const auto &primitive : gltf_mesh["primitives"].items)
+            {
+                if (primitive.get_number("mode", MODE_TRIANGLES) != MODE_TRIANGLES)
+                {
+                    Logger::get().warning("{}: skipping a primitive that is not a triangle list", path.string());
+                    continue;
+                }
+                bool has_normals = loader.append_primitive(primitive, mesh);
+                missing_normals.resize(mesh.vertices.size(), has_normals ? 0 : 1);
+                any_missing = any_missing || !has_normals;
+            }
+        }
+        if (any_missing)
+        {
+            generate_normals(mesh, missing_normals);
+        }
+        return mesh;
+    };
+
+private:
+    static constexpr uint32_t GLB_MAGIC{0x46546C67}; // "glTF"
+    static constexpr uint32_t GLB_JSON_CHUNK{0x4E4F534A};
+    static constexpr uint32_t GLB_BIN_CHUNK{0x004E4942};
+    static constexpr double MODE_TRIANGLES{4};
+    static constexpr uint32_t COMPONENT_UNSIGNED_BYTE{5121};
+    static constexpr uint32_t COMPONENT_UNSIGNED_SHORT{5123};
+    static constexpr uint32_t COMPONENT_UNSIGNED_INT{5125};
+    static constexpr uint32_t COMPONENT_FLOAT{5126};
+    static constexpr size_t CONVERT_GRAIN{1 << 16};
+
+    struct Buffer
+    {
+        const uint8_t *data;
+        size_t size;
+    };
+
+    // Strided view of one accessor inside a mapped buffer.
+    struct Accessor
+    {
+        const uint8_t *data;
+        size_t count;
+        size_t stride;
+        uint32_t component_type;
+    };
+
+    std::filesystem::path path;
+    MappedFile file;
+    std::vector<MappedFile> external_files;
+    JsonValue document;
+    std::vector<Buffer> buffers;
+
+    explicit GltfLoader(const std::filesystem::path &_path) : path{_path}, file{_path}
+    {
+        file.prefetch();
+        Buffer binary_chunk{nullptr, 0};
+        std::string_view json;
+        uint32_t magic{0};
+        if (file.size() >= sizeof(magic))
+        {
+            std::memcpy(&magic, file.data(), sizeof(magic));
+        }
+        if (magic == GLB_MAGIC)
+        {
+            read_glb(json, binary_chunk);
+        }
+        else
+        {
+            json = std::string_view{reinterpret_cast<const char *>(file.data()), file.size()};
+        }
+        document = JsonParser::parse(json);
+
+        const JsonValue *buffer_list = document.find("buffers");
+        for (size_t i = 0; buffer_list != nullptr && i < buffer_list->size(); i++)
+        {
+            const JsonValue &buffer = (*buffer_list)[i];
+            size_t length = static_cast<size_t>(buffer["byteLength"].as_number());
+            const JsonValue *uri = buffer.find("uri");
+            Buffer mapped{binary_chunk};
+            if (uri != nullptr)
+            {
+                if (uri->as_string().rfind("data:", 0) == 0)
+                {
+                    fail("embedded base64 buffers are not supported, convert the file to .glb");
+                }
+                external_files.emplace_back(path.parent_path() / std::filesystem::u8path(uri->as_string()));
+                mapped = Buffer{external_files.back().data(), external_files.back().size()};
+            }
+            if (mapped.size < length)
+            {
+                fail("buffer " + std::to_string(i) + " is shorter than its byteLength");
+            }
+            buffers.push_back(mapped);
+        }
+    };
+
+    [[noreturn]] void fail(const std::string &reason) const
+    {
+        throw std::runtime_error("Invalid glTF file " + path.string() + ": " + reason);
+    };
+
+    // Header and chunk headers are 12 and 8 bytes of little endian words, chunks are 4 byte aligned.
+    void read_glb(std::string_view &json, Buffer &binary_chunk) const
+    {
+        auto word = [this](size_t offset)
+        {
+            uint32_t value;
+            std::memcpy(&value, file.data() + offset, sizeof(value));
+            return value;
+        };
+        size_t offset{12};
+        while (offset + 8 <= file.size())
+        {
+            uint32_t length = word(offset);
+            uint32_t type = word(offset + 4);
+            offset += 8;
+            if (length > file.size() - offset)
+            {
+                fail("chunk out of range");
+            }
+            if (type == GLB_JSON_CHUNK && json.empty())
+            {
+                json = std::string_view{reinterpret_cast<const char *>(file.data() + offset), length};
+            }
+            else if (type == GLB_BIN_CHUNK && binary_chunk.data == nullptr)
+            {
+                binary_chunk = Buffer{file.data() + offset, length};
+            }
+            offset += (static_cast<size_t>(length) + 3) & ~size_t{3};
+        }
+        if (json.empty())
+        {
+            fail("no JSON chunk");
+        }
+    };
+
+    Accessor get_accessor(size_t index, uint32_t expected_components) const
+    {
+        const JsonValue &accessor = document["accessors"][index];
+        if (accessor.find("sparse") != nullptr || accessor.find("bufferView") == nullptr)
+        {
+            fail("sparse accessors are not supported");
+        }
+        const JsonValue &view = document["bufferViews"][static_cast<size_t>(accessor["bufferView"].as_number())];
+        size_t buffer_index = static_cast<size_t>(view["buffer"].as_number());
+        if (buffer_index >= buffers.size())
+        {
+            fail("buffer view references a missing buffer");
+        }
+
+        uint32_t component_type = static_cast<uint32_t>(accessor["componentType"].as_number());
+        size_t component_size = component_type == COMPONENT_UNSIGNED_BYTE ? 1 : component_type == COMPONENT_UNSIGNED_SHORT ? 2 : 4;
+        const std::string &type = accessor["type"].as_string();
+        uint32_t components = type == "SCALAR" ? 1 : type == "VEC3" ? 3 : 0;
+        if (components != expected_components)
+        {
+            fail("unexpected accessor type " + type);
+        }
+        size_t element_size = component_size * components;
+        size_t count = static_cast<size_t>(accessor["count"].as_number());
+        size_t stride = static_cast<size_t>(view.get_number("byteStride", static_cast<double>(element_size)));
+        size_t view_offset = static_cast<size_t>(view.get_number("byteOffset", 0.0));
+        size_t view_length = static_cast<size_t>(view["byteLength"].as_number());
+        size_t accessor_offset = static_cast<size_t>(accessor.get_number("byteOffset", 0.0));
+
+        const Buffer &buffer = buffers[buffer_index];
+        if (view_offset > buffer.size || view_length > buffer.size - view_offset || stride < element_size || count > view_length ||
+            (count > 0 && accessor_offset + stride * (count - 1) + element_size > view_length))
+        {
+            fail("accessor " + std::to_string(index) + " out of range");
+        }
+        return Accessor{buffer.data + view_offset + accessor_offset, count, stride, component_type};
+    };
+
+    // Appends one primitive to the mesh, returns whether it came with normals.
+    bool append_primitive(const JsonValue &primitive, Mesh &mesh) const
+    {
+        const JsonValue &attributes = primitive["attributes"];
+        Accessor positions = get_accessor(static_cast<size_t>(attributes["POSITION"].as_number()), 3);
+        const JsonValue *normal_index = attributes.find("NORMAL");
+        Accessor normals{nullptr, 0, 0, COMPONENT_FLOAT};
+        if (normal_index != nullptr)
+        {
+            normals = get_accessor(static_cast<size_t>(normal_index->as_number()), 3);
+        }
+        if (positions.component_type != COMPONENT_FLOAT || normals.component_type != COMPONENT_FLOAT ||
+            (normal_index != nullptr && normals.count != positions.count))
+        {
+            fail("positions and normals must be float VEC3 of equal count");
+        }
+
+        size_t first_vertex = mesh.vertices.size();
+        mesh.vertices.resize(first_vertex + positions.count);
+        Vertex *vertices = mesh.vertices.data() + first_vertex;
+        ThreadPool::get().parallel_for(positions.count, CONVERT_GRAIN, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; i++)
+            {
+                std::memcpy(&vertices[i].position, positions.data + i * positions.stride, sizeof(glm::vec3));
+                if (normals.data != nullptr)
+                {
+                    std::memcpy(&vertices[i].normal, normals.data + i * normals.stride, sizeof(glm::vec3));
+                }
+                else
+                {
+                    vertices[i].normal = glm::vec3(0.0f);
+                }
+            }
+        });
+
+        const JsonValue *index_accessor = primitive.find("indices");
+        size_t first_index = mesh.indices.size();
+        if (index_accessor == nullptr)
+        {
+            // Non indexed primitives draw their vertices in order.
+            mesh.indices.resize(first_index + positions.count);
+            for (size_t i = 0; i < positions.count; i++)
+            {
+                mesh.indices[first_index + i] = static_cast<int32_t>(first_vertex + i);
+            }
+            return normal_index != nullptr;
+        }
+
+        Accessor indices = get_accessor(static_cast<size_t>(index_accessor->as_number()), 1);
+        mesh.indices.resize(first_index + indices.count);
+        int32_t *output = mesh.indices.data() + first_index;
+        if (indices.component_type != COMPONENT_UNSIGNED_BYTE && indices.component_type != COMPONENT_UNSIGNED_SHORT && indices.component_type != COMPONENT_UNSIGNED_INT)
+        {
+            fail("indices must be unsigned integers");
+        }
+        std::atomic<bool> in_range{true};
+        ThreadPool::get().parallel_for(indices.count, CONVERT_GRAIN, [&](size_t begin, size_t end)
+        {
+            bool range_valid{true};
+            for (size_t i = begin; i < end; i++)
+            {
+                const uint8_t *source = indices.data + i * indices.stride;
+                uint32_t index{0};
+                if (indices.component_type == COMPONENT_UNSIGNED_BYTE)
+                {
+                    index = *source;
+                }
+                else if (indices.component_type == COMPONENT_UNSIGNED_SHORT)
+                {
+                    uint16_t value;
+                    std::memcpy(&value, source, sizeof(value));
+                    index = value;
+                }
+                else
+                {
+                    std::memcpy(&index, source, sizeof(index));
+                }
+                range_valid = range_valid && index < positions.count;
+                output[i] = static_cast<int32_t>(first_vertex + index);
+            }
+            if (!range_valid)
+            {
+                in_range.store(false, std::memory_order_relaxed);
+            }
+        });
+        if (!in_range)
+        {
+            fail("index out of range");
+        }
+        return normal_index != nullptr;
+    };
+};
+
+#endif
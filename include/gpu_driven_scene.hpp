@@ -0,0 +1,307 @@
+#ifndef GPU_DRIVEN_SCENE_HPP
+#define GPU_DRIVEN_SCENE_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "glad_extensions.hpp"
+#include "mesh.hpp"
+#include "profiler.hpp"
+#include "shader.hpp"
+#include "shader_preprocessor.hpp"
+
+// Many instances of one mesh with a fixed LOD chain, culled and drawn without per object CPU work. Object
+// transforms and bounds live in a storage buffer. gpu_cull.comp tests every object against the frustum and
+// last frame's depth pyramid, picks a LOD from its projected size and appends it to that LOD's visible list.
+// One glMultiDrawElementsIndirect then draws all LODs, the instance counts come from the compute pass.
+// Needs GL 4.3, see GladExtensions::gpu_driven.
+class GpuDrivenScene
+{
+public:
+    static constexpr uint32_t LOD_COUNT{4};
+    static constexpr uint32_t CULL_GROUP_SIZE{64};
+    static constexpr uint32_t PYRAMID_GROUP_SIZE{8};
+    // Storage buffer bindings, they match the layout(binding) qualifiers in the shaders.
+    static constexpr uint32_t OBJECT_BINDING{0};
+    static constexpr uint32_t COMMAND_BINDING{1};
+    static constexpr uint32_t VISIBLE_BINDING{2};
+    static constexpr int32_t PYRAMID_UNIT{7};
+
+    // std430 layout of ObjectData in the shaders.
+    struct GpuObject
+    {
+        glm::vec4 position_scale;
+        glm::vec4 bounds;
+    };
+
+    struct DrawElementsIndirectCommand
+    {
+        uint32_t count;
+        uint32_t instance_count;
+        uint32_t first_index;
+        int32_t base_vertex;
+        uint32_t base_instance;
+    };
+
+    GpuDrivenScene() = default;
+    GpuDrivenScene(const GpuDrivenScene &) = delete;
+    GpuDrivenScene &operator=(const GpuDrivenScene &) = delete;
+
+    ~GpuDrivenScene()
+    {
+        glDeleteVertexArrays(1, &VAO);
+        const uint32_t buffers[5]{VBO, EBO, object_buffer, command_buffer, visible_buffer};
+        glDeleteBuffers(5, buffers);
+        release_pyramid();
+    };
+
+    static ShaderDefines shader_defines(ShaderDefines defines = {})
+    {
+        defines["LOD_COUNT"] = std::to_string(LOD_COUNT);
+        return defines;
+    };
+
+    // lods[0] is the most detailed mesh, every object is drawn with one of them at its own position and scale.
+    void init(const std::vector<Mesh> &lods, const std::vector<glm::vec4> &position_scales, int32_t _width, int32_t _height)
+    {
+        if (lods.size() != LOD_COUNT)
+        {
+            throw std::runtime_error("GpuDrivenScene needs " + std::to_string(LOD_COUNT) + " LOD meshes.");
+        }
+        object_count = static_cast<uint32_t>(position_scales.size());
+
+        std::vector<Vertex> vertices;
+        std::vector<int32_t> indices;
+        mesh_radius = 0.0f;
+        for (uint32_t lod = 0; lod < LOD_COUNT; lod++)
+        {
+            // Instances of LOD l are at [l * object_count, (l + 1) * object_count) of the visible list.
+            command_template[lod] = DrawElementsIndirectCommand{static_cast<uint32_t>(lods[lod].indices.size()), 0, static_cast<uint32_t>(indices.size()),
+                                                                static_cast<int32_t>(vertices.size()), lod * object_count};
+            vertices.insert(vertices.end(), lods[lod].vertices.begin(), lods[lod].vertices.end());
+            indices.insert(indices.end(), lods[lod].indices.begin(), lods[lod].indices.end());
+        }
+        for (const auto &vertex : lods[0].vertices)
+        {
+            mesh_radius = std::max(mesh_radius, glm::length(vertex.position));
+        }
+
+        std::vector<GpuObject> objects(object_count);
+        for (uint32_t i = 0; i < object_count; i++)
+        {
+            objects[i] = GpuObject{position_scales[i], glm::vec4(glm::vec3(position_scales[i]), mesh_radius * position_scales[i].w)};
+        }
+
+        glGenVertexArrays(1, &VAO);
+        glBindVertexArray(VAO);
+
+        glGenBuffers(1, &VBO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)(0));
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)(sizeof(float) * 3));
+        glEnableVertexAttribArray(1);
+
+        glGenBuffers(1, &EBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(int32_t) * indices.size(), indices.data(), GL_STATIC_DRAW);
+
+        // The visible list doubles as a per instance attribute. base_instance offsets it per command, so the
+        // vertex shader gets its object index without GL 4.6 draw parameters.
+        glGenBuffers(1, &visible_buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, visible_buffer);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(uint32_t) * std::max<size_t>(static_cast<size_t>(object_count) * LOD_COUNT, 1), nullptr, GL_DYNAMIC_COPY);
+        glVertexAttribIPointer(2, 1, GL_UNSIGNED_INT, sizeof(uint32_t), (void *)(0));
+        glVertexAttribDivisor(2, 1);
+        glEnableVertexAttribArray(2);
+        glBindVertexArray(0);
+
+        glGenBuffers(1, &object_buffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, object_buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GpuObject) * std::max<size_t>(objects.size(), 1), objects.data(), GL_STATIC_DRAW);
+
+        glGenBuffers(1, &command_buffer);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(command_template), command_template, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        resize(_width, _height);
+    };
+
+    void resize(int32_t _width, int32_t _height)
+    {
+        if (_width <= 0 || _height <= 0)
+        {
+            return;
+        }
+        release_pyramid();
+        width = _width;
+        height = _height;
+
+        glGenTextures(1, &depth_texture);
+        glBindTexture(GL_TEXTURE_2D, depth_texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glGenFramebuffers(1, &depth_framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, depth_framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depth_texture, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        pyramid_levels = 1;
+        while ((std::max(width, height) >> pyramid_levels) > 0)
+        {
+            pyramid_levels++;
+        }
+        glGenTextures(1, &pyramid_texture);
+        glBindTexture(GL_TEXTURE_2D, pyramid_texture);
+        for (int32_t level = 0; level < pyramid_levels; level++)
+        {
+            glTexImage2D(GL_TEXTURE_2D, level, GL_R32F, std::max(width >> level, 1), std::max(height >> level, 1), 0, GL_RED, GL_FLOAT, nullptr);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, pyramid_levels - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        pyramid_valid = false;
+    };
+
+    // Fills the indirect commands and visible lists for this frame. Occlusion uses the pyramid built from the
+    // previous frame together with that frame's view projection, so it lags one frame behind like any
+    // reprojection based Hi-Z test.
+    void cull(Shader &cull_shader, const glm::mat4 &view, const glm::mat4 &projection, const glm::vec3 &camera_position)
+    {
+        PROFILE_FUNCTION();
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(command_template), command_template);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+        glm::mat4 view_projection = projection * view;
+        glm::vec4 planes[6];
+        for (int i = 0; i < 3; i++)
+        {
+            glm::vec4 row{view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]};
+            glm::vec4 last{view_projection[0][3], view_projection[1][3], view_projection[2][3], view_projection[3][3]};
+            planes[i * 2] = last + row;
+            planes[i * 2 + 1] = last - row;
+        }
+
+        static const char *const plane_names[6]{
+            "frustum_planes[0]", "frustum_planes[1]", "frustum_planes[2]", "frustum_planes[3]", "frustum_planes[4]", "frustum_planes[5]",
+        };
+        cull_shader.use();
+        for (int i = 0; i < 6; i++)
+        {
+            cull_shader.set_vec4(plane_names[i], planes[i] / glm::length(glm::vec3(planes[i])));
+        }
+        cull_shader.set_int("object_count", static_cast<int32_t>(object_count));
+        cull_shader.set_vec3("camera_position", camera_position);
+        // Projected radius in pixels is radius * lod_scale / distance.
+        cull_shader.set_float("lod_scale", projection[1][1] * height * 0.5f);
+        cull_shader.set_vec4("lod_thresholds", lod_thresholds);
+        cull_shader.set_bool("occlusion_enabled", occlusion_enabled && pyramid_valid);
+        cull_shader.set_mat4("occlusion_view_projection", pyramid_view_projection);
+        cull_shader.set_int("depth_pyramid", PYRAMID_UNIT);
+        cull_shader.set_int("pyramid_levels", pyramid_levels);
+        glActiveTexture(GL_TEXTURE0 + PYRAMID_UNIT);
+        glBindTexture(GL_TEXTURE_2D, pyramid_texture);
+        glActiveTexture(GL_TEXTURE0);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_BINDING, object_buffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BINDING, command_buffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VISIBLE_BINDING, visible_buffer);
+        glDispatchCompute((object_count + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+    };
+
+    // One call for every object of this material, whatever the object count.
+    void draw(Shader &shader) const
+    {
+        shader.use();
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_BINDING, object_buffer);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, LOD_COUNT, 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    };
+
+    // Builds the max depth pyramid from the default framebuffer, call once the frame's depth is complete.
+    void build_depth_pyramid(Shader &pyramid_shader, const glm::mat4 &view, const glm::mat4 &projection)
+    {
+        PROFILE_FUNCTION();
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, depth_framebuffer);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        pyramid_shader.use();
+        pyramid_shader.set_int("source", PYRAMID_UNIT);
+        glActiveTexture(GL_TEXTURE0 + PYRAMID_UNIT);
+        for (int32_t level = 0; level < pyramid_levels; level++)
+        {
+            glBindTexture(GL_TEXTURE_2D, level == 0 ? depth_texture : pyramid_texture);
+            pyramid_shader.set_int("source_level", level == 0 ? 0 : level - 1);
+            pyramid_shader.set_bool("copy_level", level == 0);
+            glBindImageTexture(0, pyramid_texture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+            uint32_t level_width = static_cast<uint32_t>(std::max(width >> level, 1));
+            uint32_t level_height = static_cast<uint32_t>(std::max(height >> level, 1));
+            glDispatchCompute((level_width + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE, (level_height + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE, 1);
+            glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glActiveTexture(GL_TEXTURE0);
+
+        pyramid_view_projection = projection * view;
+        pyramid_valid = true;
+    };
+
+    void set_occlusion_enabled(bool enabled) { occlusion_enabled = enabled; };
+    uint32_t get_object_count() const { return object_count; };
+
+private:
+    int32_t width{0};
+    int32_t height{0};
+    uint32_t object_count{0};
+    float mesh_radius{0.0f};
+    // Minimum projected radius in pixels for LOD 0, 1 and 2, anything smaller uses LOD 3.
+    glm::vec4 lod_thresholds{64.0f, 24.0f, 8.0f, 0.0f};
+    DrawElementsIndirectCommand command_template[LOD_COUNT]{};
+
+    uint32_t VAO{0};
+    uint32_t VBO{0};
+    uint32_t EBO{0};
+    uint32_t object_buffer{0};
+    uint32_t command_buffer{0};
+    uint32_t visible_buffer{0};
+
+    bool occlusion_enabled{true};
+    bool pyramid_valid{false};
+    int32_t pyramid_levels{1};
+    glm::mat4 pyramid_view_projection{1.0f};
+    uint32_t depth_texture{0};
+    uint32_t depth_framebuffer{0};
+    uint32_t pyramid_texture{0};
+
+    void release_pyramid()
+    {
+        glDeleteFramebuffers(1, &depth_framebuffer);
+        glDeleteTextures(1, &depth_texture);
+        glDeleteTextures(1, &pyramid_texture);
+        depth_framebuffer = 0;
+        depth_texture = 0;
+        pyramid_texture = 0;
+    };
+};
+
+#endif
@@ -0,0 +1,247 @@
+#ifndef GPU_TIMER_HPP
+#define GPU_TIMER_HPP
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "logger.hpp"
+
+// Keeps the last WINDOW samples (milliseconds) and answers min/avg/p99 over them.
+class RollingStats
+{
+public:
+    static constexpr size_t WINDOW{240};
+
+    void add(double sample)
+    {
+        samples[next % WINDOW] = sample;
+        next++;
+    };
+
+    size_t count() const { return std::min<size_t>(next, WINDOW); };
+
+    double min() const
+    {
+        return count() == 0 ? 0.0 : *std::min_element(samples.begin(), samples.begin() + count());
+    };
+
+    double avg() const
+    {
+        double sum{0.0};
+        for (size_t i = 0; i < count(); i++)
+        {
+            sum += samples[i];
+        }
+        return count() == 0 ? 0.0 : sum / count();
+    };
+
+    double percentile(double p) const
+    {
+        if (count() == 0)
+        {
+            return 0.0;
+        }
+        std::vector<double> sorted(samples.begin(), samples.begin() + count());
+        size_t index = std::min(sorted.size() - 1, static_cast<size_t>(p * (sorted.size() - 1) + 0.5));
+        std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+        return sorted[index];
+    };
+
+    double p99() const { return percentile(0.99); };
+
+private:
+    std::array<double, WINDOW> samples{};
+    size_t next{0};
+};
+
+struct GpuPassStats
+{
+    std::string name;
+    RollingStats gpu;
+    RollingStats cpu;
+};
+
+// Brackets render passes with GL_TIMESTAMP queries. Results are read FRAME_LATENCY frames later and only if
+// the driver reports them available, so reading never waits on the GPU.
+class GpuTimer
+{
+public:
+    static constexpr size_t FRAME_LATENCY{4};
+    static constexpr const char *FRAME_PASS{"frame"};
+
+    class Scope
+    {
+    private:
+        GpuTimer *timer;
+        size_t pass;
+
+    public:
+        Scope(GpuTimer *_timer, size_t _pass) : timer{_timer}, pass{_pass} {};
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+        ~Scope()
+        {
+            if (timer != nullptr)
+            {
+                timer->end_pass(pass);
+            }
+        };
+    };
+
+    GpuTimer() = default;
+    GpuTimer(const GpuTimer &) = delete;
+    GpuTimer &operator=(const GpuTimer &) = delete;
+
+    ~GpuTimer()
+    {
+        for (auto &frame : frames)
+        {
+            if (!frame.queries.empty())
+            {
+                glDeleteQueries(static_cast<int32_t>(frame.queries.size()), frame.queries.data());
+            }
+        }
+    };
+
+    void begin_frame()
+    {
+        frame_number++;
+        Frame &frame = frames[frame_number % FRAME_LATENCY];
+        collect(frame);
+        frame.used_queries = 0;
+        frame.passes.clear();
+        frame_pass = begin_pass(FRAME_PASS);
+    };
+
+    void end_frame()
+    {
+        end_pass(frame_pass);
+    };
+
+    // Returns a handle to pass to end_pass, nested passes are allowed.
+    size_t begin_pass(const char *name)
+    {
+        Frame &frame = frames[frame_number % FRAME_LATENCY];
+        PassQuery query{find_pass(name), next_query(frame), next_query(frame), now(), 0};
+        glQueryCounter(query.begin_query, GL_TIMESTAMP);
+        frame.passes.push_back(query);
+        return frame.passes.size() - 1;
+    };
+
+    void end_pass(size_t pass)
+    {
+        Frame &frame = frames[frame_number % FRAME_LATENCY];
+        glQueryCounter(frame.passes[pass].end_query, GL_TIMESTAMP);
+        frame.passes[pass].cpu_end = now();
+    };
+
+    Scope scope(const char *name) { return Scope{this, begin_pass(name)}; };
+
+    const std::vector<GpuPassStats> &stats() const { return pass_stats; };
+
+    // Results that were still not available when their frame slot was reused.
+    uint64_t dropped_count() const { return dropped; };
+
+    // GPU time above CPU submission time of the whole frame means the GPU is the bottleneck.
+    bool is_gpu_bound() const
+    {
+        return !pass_stats.empty() && pass_stats[0].gpu.avg() > pass_stats[0].cpu.avg();
+    };
+
+    void log_report() const
+    {
+        for (const auto &pass : pass_stats)
+        {
+            Logger::get().info("{}: gpu min {} avg {} p99 {} ms, cpu avg {} ms", pass.name, pass.gpu.min(), pass.gpu.avg(), pass.gpu.p99(), pass.cpu.avg());
+        }
+        if (!pass_stats.empty())
+        {
+            Logger::get().info("Frame is {}", is_gpu_bound() ? "GPU-shading-bound" : "CPU-submission-bound");
+        }
+    };
+
+private:
+    struct PassQuery
+    {
+        size_t pass;
+        uint32_t begin_query;
+        uint32_t end_query;
+        int64_t cpu_start;
+        int64_t cpu_end;
+    };
+
+    struct Frame
+    {
+        std::vector<uint32_t> queries;
+        size_t used_queries{0};
+        std::vector<PassQuery> passes;
+    };
+
+    std::array<Frame, FRAME_LATENCY> frames;
+    std::vector<GpuPassStats> pass_stats;
+    uint64_t frame_number{0};
+    uint64_t dropped{0};
+    size_t frame_pass{0};
+
+    static int64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    };
+
+    size_t find_pass(const char *name)
+    {
+        for (size_t i = 0; i < pass_stats.size(); i++)
+        {
+            if (pass_stats[i].name == name)
+            {
+                return i;
+            }
+        }
+        pass_stats.push_back(GpuPassStats{name, {}, {}});
+        return pass_stats.size() - 1;
+    };
+
+    uint32_t next_query(Frame &frame)
+    {
+        if (frame.used_queries == frame.queries.size())
+        {
+            uint32_t query;
+            glGenQueries(1, &query);
+            frame.queries.push_back(query);
+        }
+        return frame.queries[frame.used_queries++];
+    };
+
+    void collect(Frame &frame)
+    {
+        if (frame.passes.empty())
+        {
+            return;
+        }
+        // The frame pass ends after all others, so its end query being available means all of them are.
+        int32_t available{0};
+        glGetQueryObjectiv(frame.passes[0].end_query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+        {
+            dropped++;
+            return;
+        }
+        for (const auto &query : frame.passes)
+        {
+            uint64_t begin_time;
+            uint64_t end_time;
+            glGetQueryObjectui64v(query.begin_query, GL_QUERY_RESULT, &begin_time);
+            glGetQueryObjectui64v(query.end_query, GL_QUERY_RESULT, &end_time);
+            pass_stats[query.pass].gpu.add((end_time - begin_time) / 1e6);
+            pass_stats[query.pass].cpu.add((query.cpu_end - query.cpu_start) / 1e6);
+        }
+    };
+};
+
+#endif
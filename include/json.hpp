@@ -0,0 +1,333 @@
+#ifndef JSON_HPP
+#define JSON_HPP
+
+#include <charconv>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Small read only JSON document, enough for asset manifests such as glTF. Objects keep their keys in file
+// order, lookups are linear which is fine for the handful of keys per object these formats use.
+class JsonValue
+{
+public:
+    enum class Type
+    {
+        null,
+        boolean,
+        number,
+        string,
+        array,
+        object,
+    };
+
+    Type type{Type::null};
+    bool boolean{false};
+    double number{0.0};
+    std::string string;
+    // Array elements, or object values in the same order as keys.
+    std::vector<JsonValue> items;
+    std::vector<std::string> keys;
+
+    const JsonValue *find(const std::string &key) const
+    {
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            if (keys[i] == key)
+            {
+                return &items[i];
+            }
+        }
+        return nullptr;
+    };
+
+    const JsonValue &operator[](const std::string &key) const
+    {
+        const JsonValue *value = find(key);
+        if (value == nullptr)
+        {
+            throw std::runtime_error("Missing JSON key " + key);
+        }
+        return *value;
+    };
+
+    const JsonValue &operator[](size_t index) const
+    {
+        if (index >= items.size())
+        {
+            throw std::runtime_error("JSON index " + std::to_string(index) + " out of range");
+        }
+        return items[index];
+    };
+
+    size_t size() const { return items.size(); };
+    bool is_object() const { return type == Type::object; };
+    bool is_array() const { return type == Type::array; };
+
+    double as_number() const
+    {
+        if (type != Type::number)
+        {
+            throw std::runtime_error("JSON value is not a number");
+        }
+        return number;
+    };
+
+    const std::string &as_string() const
+    {
+        if (type != Type::string)
+        {
+            throw std::runtime_error("JSON value is not a string");
+        }
+        return string;
+    };
+
+    // Numeric member with a default for optional keys, e.g. glTF byteOffset.
+    double get_number(const std::string &key, double fallback) const
+    {
+        const JsonValue *value = find(key);
+        return value != nullptr ? value->as_number() : fallback;
+    };
+};
+
+class JsonParser
+{
+public:
+    static JsonValue parse(std::string_view text)
+    {
+        JsonParser parser{text};
+        parser.skip_whitespace();
+        JsonValue value = parser.parse_value(0);
+        parser.skip_whitespace();
+        if (parser.position != text.size())
+        {
+            parser.fail("trailing characters");
+        }
+        return value;
+    };
+
+private:
+    // Nesting limit, keeps a malicious file from overflowing the stack.
+    static constexpr uint32_t MAX_DEPTH{256};
+
+    std::string_view text;
+    size_t position{0};
+
+    explicit JsonParser(std::string_view _text) : text{_text} {};
+
+    [[noreturn]] void fail(const std::string &reason) const
+    {
+        throw std::runtime_error("JSON parse error at offset " + std::to_string(position) + ": " + reason);
+    };
+
+    void skip_whitespace()
+    {
+        while (position < text.size() && (text[position] == ' ' || text[position] == '\t' || text[position] == '\n' || text[position] == '\r'))
+        {
+            position++;
+        }
+    };
+
+    void expect(char c)
+    {
+        skip_whitespace();
+        if (position >= text.size() || text[position] != c)
+        {
+            fail(std::string{"expected '"} + c + "'");
+        }
+        position++;
+    };
+
+    bool consume(std::string_view literal)
+    {
+        if (text.substr(position, literal.size()) == literal)
+        {
+            position += literal.size();
+            return true;
+        }
+        return false;
+    };
+
+    JsonValue parse_value(uint32_t depth)
+    {
+        if (depth > MAX_DEPTH)
+        {
+            fail("nesting too deep");
+        }
+        skip_whitespace();
+        if (position >= text.size())
+        {
+            fail("unexpected end");
+        }
+        JsonValue value;
+        char c = text[position];
+        if (c == '{')
+        {
+            value.type = JsonValue::Type::object;
+            position++;
+            skip_whitespace();
+            if (consume("}"))
+            {
+                return value;
+            }
+            do
+            {
+                skip_whitespace();
+                value.keys.push_back(parse_string());
+                expect(':');
+                value.items.push_back(parse_value(depth + 1));
+                skip_whitespace();
+            } while (consume(","));
+            expect('}');
+        }
+        else if (c == '[')
+        {
+            value.type = JsonValue::Type::array;
+            position++;
+            skip_whitespace();
+            if (consume("]"))
+            {
+                return value;
+            }
+            do
+            {
+                value.items.push_back(parse_value(depth + 1));
+                skip_whitespace();
+            } while (consume(","));
+            expect(']');
+        }
+        else if (c == '"')
+        {
+            value.type = JsonValue::Type::string;
+            value.string = parse_string();
+        }
+        else if (consume("true"))
+        {
+            value.type = JsonValue::Type::boolean;
+            value.boolean = true;
+        }
+        else if (consume("false"))
+        {
+            value.type = JsonValue::Type::boolean;
+        }
+        else if (consume("null"))
+        {
+            value.type = JsonValue::Type::null;
+        }
+        else
+        {
+            value.type = JsonValue::Type::number;
+            const char *begin = text.data() + position;
+            auto [end, error] = std::from_chars(begin, text.data() + text.size(), value.number);
+            if (error != std::errc{})
+            {
+                fail("invalid value");
+            }
+            position += static_cast<size_t>(end - begin);
+        }
+        return value;
+    };
+
+    std::string parse_string()
+    {
+        if (position >= text.size() || text[position] != '"')
+        {
+            fail("expected string");
+        }
+        position++;
+        std::string result;
+        while (true)
+        {
+            if (position >= text.size())
+            {
+                fail("unterminated string");
+            }
+            char c = text[position++];
+            if (c == '"')
+            {
+                return result;
+            }
+            if (c != '\\')
+            {
+                result += c;
+                continue;
+            }
+            if (position >= text.size())
+            {
+                fail("unterminated escape");
+            }
+            char escape = text[position++];
+            switch (escape)
+            {
+            case '"': result += '"'; break;
+            case '\\': result += '\\'; break;
+            case '/': result += '/'; break;
+            case 'b': result += '\b'; break;
+            case 'f': result += '\f'; break;
+            case 'n': result += '\n'; break;
+            case 'r': result += '\r'; break;
+            case 't': result += '\t'; break;
+            case 'u': append_utf8(result, parse_code_point()); break;
+            default: fail("invalid escape");
+            }
+        }
+    };
+
+    uint32_t parse_hex4()
+    {
+        uint32_t value{0};
+        const char *begin = text.data() + position;
+        if (position + 4 > text.size() || std::from_chars(begin, begin + 4, value, 16).ptr != begin + 4)
+        {
+            fail("invalid unicode escape");
+        }
+        position += 4;
+        return value;
+    };
+
+    uint32_t parse_code_point()
+    {
+        uint32_t code_point = parse_hex4();
+        // Characters outside the BMP are escaped as a surrogate pair.
+        if (code_point >= 0xD800 && code_point < 0xDC00 && consume("\\u"))
+        {
+            uint32_t low = parse_hex4();
+            if (low < 0xDC00 || low >= 0xE000)
+            {
+                fail("invalid surrogate pair");
+            }
+            code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+        }
+        return code_point;
+    };
+
+    static void append_utf8(std::string &result, uint32_t code_point)
+    {
+        if (code_point < 0x80)
+        {
+            result += static_cast<char>(code_point);
+        }
+        else if (code_point < 0x800)
+        {
+            result += static_cast<char>(0xC0 | (code_point >> 6));
+            result += static_cast<char>(0x80 | (code_point & 0x3F));
+        }
+        else if (code_point < 0x10000)
+        {
+            result += static_cast<char>(0xE0 | (code_point >> 12));
+            result += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+            result += static_cast<char>(0x80 | (code_point & 0x3F));
+        }
+        else
+        {
+            result += static_cast<char>(0xF0 | (code_point >> 18));
+            result += static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+            result += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+            result += static_cast<char>(0x80 | (code_point & 0x3F));
+        }
+    };
+};
+
+#endif
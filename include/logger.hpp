@@ -0,0 +1,386 @@
+#ifndef LOGGER_HPP
+#define LOGGER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+
+enum class LogLevel : uint8_t
+{
+    trace,
+    debug,
+    info,
+    warning,
+    error,
+    off
+};
+
+// Arguments are serialized into a fixed-size record on the calling thread and formatted by the writer thread.
+// Arithmetic values are copied as is, strings are copied (and truncated) into the record.
+class LogRecord
+{
+public:
+    static constexpr size_t PAYLOAD_SIZE{232};
+
+    using FormatFunction = void (*)(const LogRecord &, std::string &);
+
+    FormatFunction format{};
+    const char *pattern{};
+    int64_t timestamp{};
+    LogLevel level{};
+    uint16_t size{};
+    std::array<char, PAYLOAD_SIZE> payload;
+
+    // spare is the number of payload bytes not reserved for fixed size arguments, strings share it.
+    template <typename T>
+    void encode(const T &value, size_t &spare)
+    {
+        if constexpr (is_string<T>())
+        {
+            std::string_view view{value};
+            uint16_t length = static_cast<uint16_t>(std::min(view.size(), spare));
+            spare -= length;
+            std::memcpy(payload.data() + size, &length, sizeof(length));
+            std::memcpy(payload.data() + size + sizeof(length), view.data(), length);
+            size += sizeof(length) + length;
+        }
+        else
+        {
+            std::memcpy(payload.data() + size, &value, sizeof(T));
+            size += sizeof(T);
+        }
+    };
+
+    template <typename T>
+    void decode(size_t &offset, std::string &out) const
+    {
+        if constexpr (is_string<T>())
+        {
+            uint16_t length{};
+            std::memcpy(&length, payload.data() + offset, sizeof(length));
+            out.append(payload.data() + offset + sizeof(length), length);
+            offset += sizeof(length) + length;
+        }
+        else
+        {
+            T value;
+            std::memcpy(&value, payload.data() + offset, sizeof(T));
+            append_value(out, value);
+            offset += sizeof(T);
+        }
+    };
+
+    template <typename T>
+    static constexpr bool is_string()
+    {
+        using Type = std::decay_t<T>;
+        return std::is_same_v<Type, std::string> || std::is_same_v<Type, std::string_view> || std::is_same_v<Type, const char *> || std::is_same_v<Type, char *>;
+    };
+
+    // Bytes a string argument needs at least (its length prefix), other arguments are stored whole.
+    template <typename T>
+    static constexpr size_t encoded_size()
+    {
+        return is_string<T>() ? sizeof(uint16_t) : sizeof(std::decay_t<T>);
+    };
+
+private:
+    static void append_value(std::string &out, bool value) { out += value ? "true" : "false"; };
+    static void append_value(std::string &out, char value) { out += value; };
+    static void append_value(std::string &out, const void *value)
+    {
+        char buffer[32];
+        int length = std::snprintf(buffer, sizeof(buffer), "%p", value);
+        out.append(buffer, static_cast<size_t>(length));
+    };
+
+    template <typename T>
+    static void append_value(std::string &out, T value)
+    {
+        static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>, "Unsupported log argument type.");
+        char buffer[32];
+        int length{};
+        if constexpr (std::is_enum_v<T>)
+        {
+            length = std::snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(value));
+        }
+        else if constexpr (std::is_floating_point_v<T>)
+        {
+            length = std::snprintf(buffer, sizeof(buffer), "%g", static_cast<double>(value));
+        }
+        else if constexpr (std::is_signed_v<T>)
+        {
+            length = std::snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(value));
+        }
+        else
+        {
+            length = std::snprintf(buffer, sizeof(buffer), "%llu", static_cast<unsigned long long>(value));
+        }
+        out.append(buffer, static_cast<size_t>(length));
+    };
+};
+
+// Bounded multi-producer single-consumer queue (sequence numbered slots), producers never block.
+template <typename T, size_t CAPACITY>
+class MpscRingBuffer
+{
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "Capacity must be a power of two.");
+
+private:
+    struct Slot
+    {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Slot[]> slots{new Slot[CAPACITY]};
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) size_t tail{0};
+
+public:
+    MpscRingBuffer()
+    {
+        for (size_t i = 0; i < CAPACITY; i++)
+        {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    };
+
+    template <typename Writer>
+    bool try_push(Writer &&writer)
+    {
+        size_t position = head.load(std::memory_order_relaxed);
+        Slot *slot;
+        while (true)
+        {
+            slot = &slots[position & (CAPACITY - 1)];
+            size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (difference == 0)
+            {
+                if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (difference < 0)
+            {
+                return false;
+            }
+            else
+            {
+                position = head.load(std::memory_order_relaxed);
+            }
+        }
+        writer(slot->value);
+        slot->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    };
+
+    // Must only be called from the single consumer thread.
+    template <typename Reader>
+    bool try_pop(Reader &&reader)
+    {
+        Slot &slot = slots[tail & (CAPACITY - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != tail + 1)
+        {
+            return false;
+        }
+        reader(slot.value);
+        slot.sequence.store(tail + CAPACITY, std::memory_order_release);
+        tail++;
+        return true;
+    };
+};
+
+class Logger
+{
+public:
+    static constexpr size_t QUEUE_CAPACITY{4096};
+    static constexpr std::chrono::milliseconds FLUSH_INTERVAL{5};
+
+    static Logger &get()
+    {
+        static Logger logger;
+        return logger;
+    };
+
+    Logger(const Logger &) = delete;
+    Logger &operator=(const Logger &) = delete;
+
+    ~Logger()
+    {
+        running.store(false, std::memory_order_release);
+        if (writer.joinable())
+        {
+            writer.join();
+        }
+        if (file != nullptr)
+        {
+            std::fclose(file);
+        }
+    };
+
+    void set_level(LogLevel _level) { level.store(_level, std::memory_order_relaxed); };
+    bool enabled(LogLevel _level) const { return _level >= level.load(std::memory_order_relaxed); };
+
+    // Additionally writes all messages to the given file, an empty path closes it.
+    bool set_file(const std::string &path)
+    {
+        std::lock_guard<std::mutex> lock{sink_mutex};
+        if (file != nullptr)
+        {
+            std::fclose(file);
+            file = nullptr;
+        }
+        if (path.empty())
+        {
+            return true;
+        }
+        file = std::fopen(path.c_str(), "a");
+        return file != nullptr;
+    };
+
+    void set_stderr(bool enable) { to_stderr.store(enable, std::memory_order_relaxed); };
+
+    // Number of messages lost because the queue was full.
+    uint64_t dropped_count() const { return dropped.load(std::memory_order_relaxed); };
+
+    // "{}" in the pattern is replaced by the next argument. The pattern must be a string literal.
+    template <typename... Args>
+    void log(LogLevel _level, const char *pattern, const Args &...args)
+    {
+        constexpr size_t fixed_size{(LogRecord::encoded_size<Args>() + ... + 0)};
+        static_assert(fixed_size <= LogRecord::PAYLOAD_SIZE, "Log arguments do not fit into a record.");
+        if (!enabled(_level))
+        {
+            return;
+        }
+        int64_t timestamp = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+        bool pushed = queue.try_push([&](LogRecord &record)
+        {
+            record.format = &format_record<Args...>;
+            record.pattern = pattern;
+            record.timestamp = timestamp;
+            record.level = _level;
+            record.size = 0;
+            [[maybe_unused]] size_t spare{LogRecord::PAYLOAD_SIZE - fixed_size};
+            (record.encode(args, spare), ...);
+        });
+        if (!pushed)
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    };
+
+    template <typename... Args> void trace(const char *pattern, const Args &...args) { log(LogLevel::trace, pattern, args...); };
+    template <typename... Args> void debug(const char *pattern, const Args &...args) { log(LogLevel::debug, pattern, args...); };
+    template <typename... Args> void info(const char *pattern, const Args &...args) { log(LogLevel::info, pattern, args...); };
+    template <typename... Args> void warning(const char *pattern, const Args &...args) { log(LogLevel::warning, pattern, args...); };
+    template <typename... Args> void error(const char *pattern, const Args &...args) { log(LogLevel::error, pattern, args...); };
+
+private:
+    MpscRingBuffer<LogRecord, QUEUE_CAPACITY> queue;
+    std::atomic<LogLevel> level{LogLevel::info};
+    std::atomic<bool> running{true};
+    std::atomic<bool> to_stderr{true};
+    std::atomic<uint64_t> dropped{0};
+    uint64_t reported_dropped{0};
+    std::chrono::steady_clock::time_point start_time{std::chrono::steady_clock::now()};
+
+    std::mutex sink_mutex;
+    std::FILE *file{nullptr};
+    std::string batch;
+
+    std::thread writer;
+
+    Logger()
+    {
+        batch.reserve(64 * 1024);
+        writer = std::thread{&Logger::writer_loop, this};
+    };
+
+    template <typename... Args>
+    static void format_record(const LogRecord &record, std::string &out)
+    {
+        static constexpr const char *LEVEL_NAMES[]{"TRACE", "DEBUG", "INFO ", "WARN ", "ERROR"};
+        char header[48];
+        int length = std::snprintf(header, sizeof(header), "[%10.6f] [%s] ", record.timestamp / 1e6, LEVEL_NAMES[static_cast<size_t>(record.level)]);
+        out.append(header, static_cast<size_t>(length));
+
+        const char *pattern = record.pattern;
+        size_t offset{0};
+        [[maybe_unused]] auto next_argument = [&](auto tag)
+        {
+            const char *placeholder = std::strstr(pattern, "{}");
+            if (placeholder == nullptr)
+            {
+                return;
+            }
+            out.append(pattern, static_cast<size_t>(placeholder - pattern));
+            pattern = placeholder + 2;
+            record.decode<typename decltype(tag)::type>(offset, out);
+        };
+        (next_argument(std::common_type<std::decay_t<Args>>{}), ...);
+        out += pattern;
+        out += '\n';
+    };
+
+    void writer_loop()
+    {
+        while (true)
+        {
+            bool stopping = !running.load(std::memory_order_acquire);
+            drain();
+            if (stopping)
+            {
+                break;
+            }
+            std::this_thread::sleep_for(FLUSH_INTERVAL);
+        }
+    };
+
+    void drain()
+    {
+        while (queue.try_pop([this](const LogRecord &record) { record.format(record, batch); }))
+        {
+        }
+
+        uint64_t total_dropped = dropped.load(std::memory_order_relaxed);
+        if (total_dropped != reported_dropped)
+        {
+            batch += "[logger] dropped " + std::to_string(total_dropped - reported_dropped) + " messages, queue was full\n";
+            reported_dropped = total_dropped;
+        }
+        if (batch.empty())
+        {
+            return;
+        }
+
+        if (to_stderr.load(std::memory_order_relaxed))
+        {
+            std::fwrite(batch.data(), 1, batch.size(), stderr);
+        }
+        {
+            std::lock_guard<std::mutex> lock{sink_mutex};
+            if (file != nullptr)
+            {
+                std::fwrite(batch.data(), 1, batch.size(), file);
+                std::fflush(file);
+            }
+        }
+        batch.clear();
+    };
+};
+
+#endif
@@ -0,0 +1,171 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read only view of a whole file mapped into the address space. Pages are faulted in by the OS on first
+// touch, so reading from the view costs no allocation and no copy on our side.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::filesystem::path &path)
+    {
+        open(path);
+    };
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&file) noexcept
+    {
+        swap(file);
+    };
+    MappedFile &operator=(MappedFile &&file) noexcept
+    {
+        if (this != &file)
+        {
+            close();
+            swap(file);
+        }
+        return *this;
+    };
+    ~MappedFile()
+    {
+        close();
+    };
+
+    const uint8_t *data() const { return bytes; };
+    size_t size() const { return length; };
+    bool is_open() const { return bytes != nullptr; };
+
+    // Hints that the whole file is about to be read front to back, so the OS can start reading ahead.
+    void prefetch() const
+    {
+#ifndef _WIN32
+        if (bytes != nullptr)
+        {
+            // Advice values are not flags, each one is a separate call.
+            madvise(const_cast<uint8_t *>(bytes), length, MADV_SEQUENTIAL);
+            madvise(const_cast<uint8_t *>(bytes), length, MADV_WILLNEED);
+        }
+#endif
+    };
+
+    void close()
+    {
+#ifdef _WIN32
+        if (bytes != nullptr)
+        {
+            UnmapViewOfFile(bytes);
+        }
+        if (mapping != nullptr)
+        {
+            CloseHandle(mapping);
+        }
+        if (file != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(file);
+        }
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (bytes != nullptr)
+        {
+            munmap(const_cast<uint8_t *>(bytes), length);
+        }
+#endif
+        bytes = nullptr;
+        length = 0;
+    };
+
+private:
+    const uint8_t *bytes{nullptr};
+    size_t length{0};
+#ifdef _WIN32
+    HANDLE file{INVALID_HANDLE_VALUE};
+    HANDLE mapping{nullptr};
+#endif
+
+    void open(const std::filesystem::path &path)
+    {
+#ifdef _WIN32
+        file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        LARGE_INTEGER file_size{};
+        if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &file_size))
+        {
+            close();
+            throw std::runtime_error("Failed to open " + path.string());
+        }
+        length = static_cast<size_t>(file_size.QuadPart);
+        // Empty files can not be mapped, they are left open with a null view.
+        if (length == 0)
+        {
+            return;
+        }
+        mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        void *view = mapping != nullptr ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (view == nullptr)
+        {
+            close();
+            throw std::runtime_error("Failed to map " + path.string());
+        }
+        bytes = static_cast<const uint8_t *>(view);
+#else
+        int descriptor = ::open(path.c_str(), O_RDONLY);
+        struct stat status{};
+        if (descriptor < 0 || fstat(descriptor, &status) != 0)
+        {
+            if (descriptor >= 0)
+            {
+                ::close(descriptor);
+            }
+            throw std::runtime_error("Failed to open " + path.string());
+        }
+        length = static_cast<size_t>(status.st_size);
+        if (length == 0)
+        {
+            ::close(descriptor);
+            return;
+        }
+        // The mapping keeps its own reference to the file, the descriptor is not needed past this point.
+        void *view = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        ::close(descriptor);
+        if (view == MAP_FAILED)
+        {
+            length = 0;
+            throw std::runtime_error("Failed to map " + path.string());
+        }
+        bytes = static_cast<const uint8_t *>(view);
+#endif
+    };
+
+    void swap(MappedFile &other) noexcept
+    {
+        std::swap(bytes, other.bytes);
+        std::swap(length, other.length);
+#ifdef _WIN32
+        std::swap(file, other.file);
+        std::swap(mapping, other.mapping);
+#endif
+    };
+};
+
+#endif
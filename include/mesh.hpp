@@ -1,9 +1,12 @@
 #ifndef MESH_HPP
 #define MESH_HPP
 
+#include <cmath>
 #include <cstdint>
+#include <stdexcept>
 #include <vector>
 
+#include <glm/glm.hpp>
 #include <glm/vec3.hpp>
 
 struct Vertex
@@ -19,6 +22,55 @@ struct Mesh
     glm::vec3 color;
 };
 
+// Axis aligned box in mesh space.
+struct Bounds
+{
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+inline Bounds get_mesh_bounds(const Mesh &mesh)
+{
+    if (mesh.vertices.empty())
+    {
+        return Bounds{glm::vec3(0.0f), glm::vec3(0.0f)};
+    }
+    Bounds bounds{mesh.vertices[0].position, mesh.vertices[0].position};
+    for (const auto &vertex : mesh.vertices)
+    {
+        bounds.min = glm::min(bounds.min, vertex.position);
+        bounds.max = glm::max(bounds.max, vertex.position);
+    }
+    return bounds;
+}
+
+// Area weighted smooth normals for the vertices flagged in missing, the other vertices keep their normal.
+// Used by the loaders for files that come without normals.
+inline void generate_normals(Mesh &mesh, const std::vector<uint8_t> &missing)
+{
+    std::vector<glm::vec3> sums(mesh.vertices.size(), glm::vec3(0.0f));
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+    {
+        uint32_t a = static_cast<uint32_t>(mesh.indices[i]);
+        uint32_t b = static_cast<uint32_t>(mesh.indices[i + 1]);
+        uint32_t c = static_cast<uint32_t>(mesh.indices[i + 2]);
+        // The cross product length is twice the triangle area, which gives the weighting for free.
+        glm::vec3 normal = glm::cross(mesh.vertices[b].position - mesh.vertices[a].position, mesh.vertices[c].position - mesh.vertices[a].position);
+        sums[a] += normal;
+        sums[b] += normal;
+        sums[c] += normal;
+    }
+    for (size_t i = 0; i < mesh.vertices.size(); i++)
+    {
+        if (missing[i])
+        {
+            float length = glm::length(sums[i]);
+            mesh.vertices[i].normal = length > 0.0f ? sums[i] / length : glm::vec3(0.0f, 1.0f, 0.0f);
+        }
+    }
+}
+
+// Triangles are wound counter-clockwise seen from outside, so back face culling works on the result.
 Mesh get_sphere_mesh(uint32_t segments, uint32_t ring_segments, float radius, const glm::vec3 &color)
 {
     if (segments < 2 || ring_segments < 3 || radius <= 0.0f)
@@ -74,24 +126,24 @@ Mesh get_sphere_mesh(uint32_t segments, uint32_t ring_segments, float radius, co
             else if (i == segments - 1)
             {
                 result_mesh.indices.push_back(ring_segments * i + 1);
-                result_mesh.indices.push_back(ring_segments * (i - 1) + j + 1);
                 if (j == ring_segments - 1)
                     result_mesh.indices.push_back(ring_segments * (i - 1) + (j + 2) % ring_segments);
                 else
                     result_mesh.indices.push_back(ring_segments * (i - 1) + j + 2);
+                result_mesh.indices.push_back(ring_segments * (i - 1) + j + 1);
             }
             else
             {
                 result_mesh.indices.push_back(ring_segments * (i - 1) + j + 1);
                 if (j == ring_segments - 1)
                 {
-                    result_mesh.indices.push_back(ring_segments * (i - 1) + (j + 2) % ring_segments);
                     result_mesh.indices.push_back(ring_segments * (i - 1) + (j + 2));
+                    result_mesh.indices.push_back(ring_segments * (i - 1) + (j + 2) % ring_segments);
                 }
                 else
                 {
-                    result_mesh.indices.push_back(ring_segments * (i - 1) + (j + 2));
                     result_mesh.indices.push_back(ring_segments * (i - 1) + j + 2 + ring_segments);
+                    result_mesh.indices.push_back(ring_segments * (i - 1) + (j + 2));
                 }
 
                 result_mesh.indices.push_back(ring_segments * (i - 1) + j + 1);
@@ -112,4 +164,54 @@ Mesh get_sphere_mesh(uint32_t segments, uint32_t ring_segments, float radius, co
     return result_mesh;
 };
 
+// Square in the XZ plane centered on the origin, facing +Y.
+Mesh get_plane_mesh(float size, const glm::vec3 &color)
+{
+    if (size <= 0.0f)
+    {
+        throw std::runtime_error("Wrong parameters");
+    }
+    float half_size = size / 2.0f;
+    glm::vec3 normal{0.0f, 1.0f, 0.0f};
+    Mesh result_mesh;
+    result_mesh.vertices = {
+        Vertex{glm::vec3(-half_size, 0.0f, -half_size), normal},
+        Vertex{glm::vec3(-half_size, 0.0f, half_size), normal},
+        Vertex{glm::vec3(half_size, 0.0f, half_size), normal},
+        Vertex{glm::vec3(half_size, 0.0f, -half_size), normal},
+    };
+    result_mesh.indices = {0, 1, 2, 0, 2, 3};
+    result_mesh.color = color;
+    return result_mesh;
+};
+
+// Regular icosahedron with its vertices on the sphere, the coarsest closed mesh to subdivide a sphere from.
+inline Mesh get_icosahedron_mesh(float radius, const glm::vec3 &color)
+{
+    if (radius <= 0.0f)
+    {
+        throw std::runtime_error("Wrong parameters");
+    }
+    const float t = (1.0f + std::sqrt(5.0f)) / 2.0f;
+    const glm::vec3 corners[12]{
+        {-1.0f, t, 0.0f}, {1.0f, t, 0.0f}, {-1.0f, -t, 0.0f}, {1.0f, -t, 0.0f},
+        {0.0f, -1.0f, t}, {0.0f, 1.0f, t}, {0.0f, -1.0f, -t}, {0.0f, 1.0f, -t},
+        {t, 0.0f, -1.0f}, {t, 0.0f, 1.0f}, {-t, 0.0f, -1.0f}, {-t, 0.0f, 1.0f},
+    };
+    Mesh result_mesh;
+    for (const auto &corner : corners)
+    {
+        glm::vec3 normal = glm::normalize(corner);
+        result_mesh.vertices.push_back(Vertex{normal * radius, normal});
+    }
+    result_mesh.indices = {
+        0, 11, 5, 0, 5, 1, 0, 1, 7, 0, 7, 10, 0, 10, 11,
+        1, 5, 9, 5, 11, 4, 11, 10, 2, 10, 7, 6, 7, 1, 8,
+        3, 9, 4, 3, 4, 2, 3, 2, 6, 3, 6, 8, 3, 8, 9,
+        4, 9, 5, 2, 4, 11, 6, 2, 10, 8, 6, 7, 9, 8, 1,
+    };
+    result_mesh.color = color;
+    return result_mesh;
+}
+
 #endif
\ No newline at end of file
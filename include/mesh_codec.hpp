@@ -0,0 +1,488 @@
+#ifndef MESH_CODEC_HPP
+#define MESH_CODEC_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MESH_CODEC_AVX2 1
+#endif
+
+// Every x64 build carries the SSSE3 decoder. Unless the compiler may assume SSSE3 it is compiled for that
+// target alone and picked at runtime after a CPUID check.
+#if defined(__x86_64__) || defined(_M_X64)
+#include <tmmintrin.h>
+#define MESH_CODEC_SSSE3 1
+#if defined(__SSSE3__) || defined(_MSC_VER)
+#define MESH_CODEC_TARGET_SSSE3
+#else
+#define MESH_CODEC_TARGET_SSSE3 __attribute__((target("ssse3")))
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#include <glm/glm.hpp>
+
+#include "atomic_file.hpp"
+#include "mapped_file.hpp"
+#include "mesh.hpp"
+#include "profiler.hpp"
+#include "thread_pool.hpp"
+
+// Lossy compression for baked meshes. Positions are quantized to 16 bits inside the mesh bounds and
+// normals to 16 bit octahedral coordinates. Every component becomes its own stream (the vertex data is
+// transposed) and is delta coded against the previous value. Indices are one more stream, coded relative
+// to their triangle: the first corner against the first corner of the previous triangle, the other two
+// against the first corner. All streams are zigzag mapped and written as Stream VByte: 2 bit lengths for
+// four values in a control byte, followed by the 1-4 significant bytes of each value. Decoding expands
+// four values per shuffle with SSSE3 and prefix sums the deltas in registers, the streams are decoded in
+// parallel. Build with ENABLE_AVX2 to also dequantize eight components per instruction.
+class MeshCodec
+{
+public:
+    static constexpr uint32_t MAGIC{0x5A48534D}; // "MSHZ"
+    static constexpr uint32_t VERSION{2};
+
+    static std::vector<uint8_t> encode(const Mesh &mesh)
+    {
+        PROFILE_FUNCTION();
+        Bounds bounds = get_mesh_bounds(mesh);
+        Header header{};
+        header.magic = MAGIC;
+        header.version = VERSION;
+        header.vertex_count = static_cast<uint32_t>(mesh.vertices.size());
+        header.index_count = static_cast<uint32_t>(mesh.indices.size());
+        for (uint32_t i = 0; i < 3; i++)
+        {
+            header.bounds_min[i] = bounds.min[i];
+            header.bounds_max[i] = bounds.max[i];
+            header.color[i] = mesh.color[i];
+        }
+
+        std::array<std::vector<uint32_t>, STREAM_COUNT> streams;
+        for (auto &stream : streams)
+        {
+            stream.reserve(mesh.vertices.size());
+        }
+        glm::vec3 extent = bounds.max - bounds.min;
+        for (const auto &vertex : mesh.vertices)
+        {
+            for (uint32_t axis = 0; axis < 3; axis++)
+            {
+                float t = extent[axis] > 0.0f ? (vertex.position[axis] - bounds.min[axis]) / extent[axis] : 0.0f;
+                streams[axis].push_back(static_cast<uint32_t>(std::lround(std::clamp(t, 0.0f, 1.0f) * QUANTIZATION_MAX)));
+            }
+            glm::vec2 octahedral = encode_octahedral(vertex.normal);
+            streams[NORMAL_U].push_back(static_cast<uint32_t>(std::lround((octahedral.x * 0.5f + 0.5f) * QUANTIZATION_MAX)));
+            streams[NORMAL_V].push_back(static_cast<uint32_t>(std::lround((octahedral.y * 0.5f + 0.5f) * QUANTIZATION_MAX)));
+        }
+        streams[INDICES] = encode_triangles(mesh.indices);
+
+        std::vector<uint8_t> result(sizeof(Header));
+        std::memcpy(result.data(), &header, sizeof(Header));
+        for (uint32_t i = 0; i < STREAM_COUNT; i++)
+        {
+            encode_stream(streams[i], i != INDICES, result);
+        }
+        return result;
+    };
+
+    static Mesh decode(const uint8_t *data, size_t size)
+    {
+        PROFILE_FUNCTION();
+        if (size < sizeof(Header))
+        {
+            throw std::runtime_error("Compressed mesh is truncated");
+        }
+        Header header;
+        std::memcpy(&header, data, sizeof(Header));
+        if (header.magic != MAGIC || header.version != VERSION)
+        {
+            throw std::runtime_error("Compressed mesh has an unknown format");
+        }
+
+        // Locate the streams first, they are decoded independently.
+        std::array<StreamView, STREAM_COUNT> views;
+        size_t offset{sizeof(Header)};
+        for (uint32_t i = 0; i < STREAM_COUNT; i++)
+        {
+            uint32_t length{0};
+            if (size - offset < sizeof(length))
+            {
+                throw std::runtime_error("Compressed mesh is truncated");
+            }
+            std::memcpy(&length, data + offset, sizeof(length));
+            offset += sizeof(length);
+            if (length > size - offset)
+            {
+                throw std::runtime_error("Compressed mesh is truncated");
+            }
+            // Every value takes at least one byte, so a count the stream cannot hold is rejected before
+            // anything is allocated for it.
+            uint32_t count = i == INDICES ? header.index_count : header.vertex_count;
+            if (length < (static_cast<uint64_t>(count) + 3) / 4 + count + STREAM_PADDING)
+            {
+                throw std::runtime_error("Compressed mesh stream is corrupt");
+            }
+            views[i] = StreamView{data + offset, data + offset + length, count};
+            offset += length;
+        }
+
+        // Allocated here, the parallel_for body must not throw.
+        std::array<std::vector<uint32_t>, STREAM_COUNT> streams;
+        for (uint32_t i = 0; i < STREAM_COUNT; i++)
+        {
+            streams[i].resize(views[i].count);
+        }
+        bool streams_valid[STREAM_COUNT]{};
+        ThreadPool::get().parallel_for(STREAM_COUNT, 1, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; i++)
+            {
+                streams_valid[i] = decode_stream(views[i], i != INDICES, streams[i].data());
+                if (i == INDICES && streams_valid[i])
+                {
+                    streams_valid[i] = decode_triangles(streams[i].data(), views[i].count, header.vertex_count);
+                }
+            }
+        });
+        for (bool valid : streams_valid)
+        {
+            if (!valid)
+            {
+                throw std::runtime_error("Compressed mesh stream is corrupt");
+            }
+        }
+
+        Mesh mesh;
+        mesh.color = glm::vec3(header.color[0], header.color[1], header.color[2]);
+        mesh.vertices.resize(header.vertex_count);
+        mesh.indices.resize(header.index_count);
+        std::memcpy(mesh.indices.data(), streams[INDICES].data(), sizeof(uint32_t) * header.index_count);
+        ThreadPool::get().parallel_for(header.vertex_count, DEQUANTIZE_GRAIN, [&](size_t begin, size_t end)
+        {
+            dequantize(header, streams, mesh.vertices.data(), begin, end);
+        });
+        return mesh;
+    };
+
+    static void write(const std::filesystem::path &path, const Mesh &mesh)
+    {
+        std::vector<uint8_t> encoded = encode(mesh);
+        if (!write_file_atomically(path, encoded.data(), encoded.size()))
+        {
+            throw std::runtime_error("Failed to write " + path.string());
+        }
+    };
+
+    static Mesh load(const std::filesystem::path &path)
+    {
+        MappedFile file{path};
+        file.prefetch();
+        return decode(file.data(), file.size());
+    };
+
+    // Whether the file exists and was written by this version of the codec.
+    static bool is_current(const std::filesystem::path &path)
+    {
+        std::ifstream file{path, std::ios::binary};
+        Header header{};
+        file.read(reinterpret_cast<char *>(&header), sizeof(header));
+        return file && header.magic == MAGIC && header.version == VERSION;
+    };
+
+private:
+    static constexpr uint32_t STREAM_COUNT{6};
+    static constexpr uint32_t NORMAL_U{3};
+    static constexpr uint32_t NORMAL_V{4};
+    static constexpr uint32_t INDICES{5};
+    static constexpr float QUANTIZATION_MAX{65535.0f};
+    // Zero bytes after every stream, so the SIMD decoder can always load 16 bytes.
+    static constexpr size_t STREAM_PADDING{16};
+    static constexpr size_t DEQUANTIZE_GRAIN{1 << 14};
+    static constexpr size_t DEQUANTIZE_ROW{1024};
+
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vertex_count;
+        uint32_t index_count;
+        float bounds_min[3];
+        float bounds_max[3];
+        float color[3];
+        uint32_t reserved;
+    };
+
+    struct StreamView
+    {
+        const uint8_t *begin;
+        const uint8_t *end;
+        uint32_t count;
+    };
+
+    static glm::vec2 encode_octahedral(const glm::vec3 &normal)
+    {
+        float sum = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+        if (sum == 0.0f)
+        {
+            return glm::vec2(0.0f);
+        }
+        glm::vec2 result{normal.x / sum, normal.y / sum};
+        if (normal.z < 0.0f)
+        {
+            result = glm::vec2((1.0f - std::abs(result.y)) * (result.x >= 0.0f ? 1.0f : -1.0f), (1.0f - std::abs(result.x)) * (result.y >= 0.0f ? 1.0f : -1.0f));
+        }
+        return result;
+    };
+
+    static glm::vec3 decode_octahedral(float u, float v)
+    {
+        glm::vec3 normal{u, v, 1.0f - std::abs(u) - std::abs(v)};
+        float fold = std::max(-normal.z, 0.0f);
+        normal.x += normal.x >= 0.0f ? -fold : fold;
+        normal.y += normal.y >= 0.0f ? -fold : fold;
+        return glm::normalize(normal);
+    };
+
+    // Triangle relative form of the indices, decode_triangles() undoes it.
+    static std::vector<uint32_t> encode_triangles(const std::vector<int32_t> &indices)
+    {
+        std::vector<uint32_t> result(indices.size());
+        uint32_t anchor{0};
+        for (size_t i = 0; i < indices.size(); i++)
+        {
+            uint32_t index = static_cast<uint32_t>(indices[i]);
+            result[i] = index - anchor;
+            if (i % 3 == 0)
+            {
+                anchor = index;
+            }
+        }
+        return result;
+    };
+
+    // False if an index addresses a vertex the mesh does not have, the draw would read out of bounds.
+    static bool decode_triangles(uint32_t *values, size_t count, uint32_t vertex_count)
+    {
+        uint32_t anchor{0};
+        bool valid{true};
+        for (size_t i = 0; i < count; i++)
+        {
+            values[i] += anchor;
+            if (i % 3 == 0)
+            {
+                anchor = values[i];
+            }
+            valid &= values[i] < vertex_count;
+        }
+        return valid;
+    };
+
+    // Values are delta coded against the previous one if delta is set, otherwise written as they are.
+    static void encode_stream(const std::vector<uint32_t> &values, bool delta, std::vector<uint8_t> &output)
+    {
+        size_t length_offset = output.size();
+        output.resize(length_offset + sizeof(uint32_t));
+        size_t control_offset = output.size();
+        output.resize(control_offset + (values.size() + 3) / 4, 0);
+
+        uint32_t previous{0};
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            uint32_t value = delta ? values[i] - previous : values[i];
+            previous = values[i];
+            uint32_t zigzag = (value << 1) ^ static_cast<uint32_t>(static_cast<int32_t>(value) >> 31);
+            uint32_t bytes = zigzag < (1u << 8) ? 1 : zigzag < (1u << 16) ? 2 : zigzag < (1u << 24) ? 3 : 4;
+            output[control_offset + i / 4] |= static_cast<uint8_t>((bytes - 1) << ((i % 4) * 2));
+            for (uint32_t b = 0; b < bytes; b++)
+            {
+                output.push_back(static_cast<uint8_t>(zigzag >> (b * 8)));
+            }
+        }
+        output.resize(output.size() + STREAM_PADDING, 0);
+
+        uint32_t length = static_cast<uint32_t>(output.size() - control_offset);
+        std::memcpy(output.data() + length_offset, &length, sizeof(length));
+    };
+
+#if MESH_CODEC_SSSE3
+    struct ShuffleTables
+    {
+        alignas(16) uint8_t shuffles[256][16];
+        uint8_t lengths[256];
+    };
+
+    // For every control byte, the pshufb mask that spreads the packed bytes of four values into four lanes.
+    static const ShuffleTables &shuffle_tables()
+    {
+        static const ShuffleTables tables = []
+        {
+            ShuffleTables result{};
+            for (uint32_t key = 0; key < 256; key++)
+            {
+                uint8_t offset{0};
+                for (uint32_t lane = 0; lane < 4; lane++)
+                {
+                    uint32_t bytes = ((key >> (lane * 2)) & 3) + 1;
+                    for (uint32_t b = 0; b < 4; b++)
+                    {
+                        result.shuffles[key][lane * 4 + b] = b < bytes ? static_cast<uint8_t>(offset + b) : 0x80;
+                    }
+                    offset = static_cast<uint8_t>(offset + bytes);
+                }
+                result.lengths[key] = offset;
+            }
+            return result;
+        }();
+        return tables;
+    };
+
+    static bool has_ssse3()
+    {
+#if defined(__SSSE3__)
+        return true;
+#elif defined(_MSC_VER)
+        static const bool supported = []
+        {
+            int info[4];
+            __cpuid(info, 1);
+            return (info[2] & (1 << 9)) != 0;
+        }();
+        return supported;
+#else
+        static const bool supported = __builtin_cpu_supports("ssse3");
+        return supported;
+#endif
+    };
+
+    // Decodes whole groups of four while 16 bytes can be loaded, returns how many values were written.
+    MESH_CODEC_TARGET_SSSE3 static uint32_t decode_groups_ssse3(const StreamView &stream, const uint8_t *control, const uint8_t *&data, bool delta, uint32_t *output, uint32_t &previous)
+    {
+        const ShuffleTables &tables = shuffle_tables();
+        const __m128i one = _mm_set1_epi32(1);
+        __m128i running = _mm_setzero_si128();
+        uint32_t i{0};
+        // A group reads 16 bytes and uses at most that many, the padding keeps the last loads in bounds.
+        for (; i + 4 <= stream.count && data + 16 <= stream.end; i += 4)
+        {
+            uint8_t key = control[i / 4];
+            __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+            __m128i values = _mm_shuffle_epi8(packed, _mm_load_si128(reinterpret_cast<const __m128i *>(tables.shuffles[key])));
+            data += tables.lengths[key];
+            // Zigzag: (v >> 1) ^ -(v & 1).
+            values = _mm_xor_si128(_mm_srli_epi32(values, 1), _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(values, one)));
+            if (delta)
+            {
+                // Inclusive prefix sum of the four deltas, then the last value of the previous group.
+                values = _mm_add_epi32(values, _mm_slli_si128(values, 4));
+                values = _mm_add_epi32(values, _mm_slli_si128(values, 8));
+                values = _mm_add_epi32(values, running);
+                running = _mm_shuffle_epi32(values, _MM_SHUFFLE(3, 3, 3, 3));
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(output + i), values);
+        }
+        previous = static_cast<uint32_t>(_mm_cvtsi128_si32(running));
+        return i;
+    };
+#endif
+
+    // Undoes the byte packing, zigzag and, if delta is set, delta coding. False if the stream is shorter
+    // than its count needs.
+    static bool decode_stream(const StreamView &stream, bool delta, uint32_t *output)
+    {
+        size_t control_size = (static_cast<size_t>(stream.count) + 3) / 4;
+        if (static_cast<size_t>(stream.end - stream.begin) < control_size + STREAM_PADDING)
+        {
+            return false;
+        }
+        const uint8_t *control = stream.begin;
+        const uint8_t *data = stream.begin + control_size;
+        uint32_t i{0};
+        uint32_t previous{0};
+
+#if MESH_CODEC_SSSE3
+        if (has_ssse3())
+        {
+            i = decode_groups_ssse3(stream, control, data, delta, output, previous);
+        }
+#endif
+
+        for (; i < stream.count; i++)
+        {
+            uint32_t bytes = ((control[i / 4] >> ((i % 4) * 2)) & 3) + 1;
+            if (static_cast<size_t>(stream.end - data) < bytes)
+            {
+                return false;
+            }
+            uint32_t zigzag{0};
+            for (uint32_t b = 0; b < bytes; b++)
+            {
+                zigzag |= static_cast<uint32_t>(data[b]) << (b * 8);
+            }
+            data += bytes;
+            uint32_t value = (zigzag >> 1) ^ (0u - (zigzag & 1));
+            previous = delta ? previous + value : value;
+            output[i] = previous;
+        }
+        return data <= stream.end - STREAM_PADDING;
+    };
+
+    static void dequantize(const Header &header, const std::array<std::vector<uint32_t>, STREAM_COUNT> &streams, Vertex *vertices, size_t begin, size_t end)
+    {
+        float scale[3];
+        for (uint32_t axis = 0; axis < 3; axis++)
+        {
+            scale[axis] = (header.bounds_max[axis] - header.bounds_min[axis]) / QUANTIZATION_MAX;
+        }
+        // Positions per axis into a scratch row first, that loop is a straight multiply add over a stream.
+        float positions[3][DEQUANTIZE_ROW];
+        for (size_t first = begin; first < end; first += DEQUANTIZE_ROW)
+        {
+            size_t count = std::min(end - first, DEQUANTIZE_ROW);
+            for (uint32_t axis = 0; axis < 3; axis++)
+            {
+                dequantize_row(streams[axis].data() + first, count, header.bounds_min[axis], scale[axis], positions[axis]);
+            }
+            for (size_t i = 0; i < count; i++)
+            {
+                Vertex &vertex = vertices[first + i];
+                vertex.position = glm::vec3(positions[0][i], positions[1][i], positions[2][i]);
+                float u = streams[NORMAL_U][first + i] * (2.0f / QUANTIZATION_MAX) - 1.0f;
+                float v = streams[NORMAL_V][first + i] * (2.0f / QUANTIZATION_MAX) - 1.0f;
+                vertex.normal = decode_octahedral(u, v);
+            }
+        }
+    };
+
+    static void dequantize_row(const uint32_t *quantized, size_t count, float offset, float scale, float *output)
+    {
+        size_t i{0};
+#if MESH_CODEC_AVX2
+        __m256 offsets = _mm256_set1_ps(offset);
+        __m256 scales = _mm256_set1_ps(scale);
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256 values = _mm256_cvtepi32_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(quantized + i)));
+            _mm256_storeu_ps(output + i, _mm256_add_ps(offsets, _mm256_mul_ps(values, scales)));
+        }
+#endif
+        for (; i < count; i++)
+        {
+            output[i] = offset + static_cast<float>(quantized[i]) * scale;
+        }
+    };
+};
+
+#endif
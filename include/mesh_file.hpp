@@ -0,0 +1,224 @@
+#ifndef MESH_FILE_HPP
+#define MESH_FILE_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "atomic_file.hpp"
+#include "mapped_file.hpp"
+#include "mesh.hpp"
+
+// Baked mesh container, laid out so the streams can be handed to the driver straight from a mapping:
+//
+//   MeshFileHeader | vertex stream | index stream | MeshFileLod table
+//
+// Every section starts on a MESH_FILE_ALIGNMENT boundary. Vertices are stored as Vertex, indices as 32 bit
+// unsigned, all little endian. LODs are ranges of both streams, index values are relative to the LOD's
+// first vertex.
+constexpr uint32_t MESH_FILE_MAGIC{0x4853454D}; // "MESH"
+constexpr uint32_t MESH_FILE_VERSION{1};
+constexpr uint64_t MESH_FILE_ALIGNMENT{64};
+
+struct MeshFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertex_stride;
+    uint32_t lod_count;
+    uint64_t vertex_offset;
+    uint64_t vertex_count;
+    uint64_t index_offset;
+    uint64_t index_count;
+    uint64_t lod_offset;
+    float bounds_min[3];
+    float bounds_max[3];
+    float color[3];
+    uint32_t reserved;
+};
+static_assert(sizeof(MeshFileHeader) == 96, "MeshFileHeader is part of the file format");
+
+struct MeshFileLod
+{
+    uint32_t first_vertex;
+    uint32_t vertex_count;
+    uint32_t first_index;
+    uint32_t index_count;
+};
+static_assert(sizeof(MeshFileLod) == 16, "MeshFileLod is part of the file format");
+
+// Writes the LOD chain, finest first. Bounds and color are taken from the finest level.
+inline void write_mesh_file(const std::filesystem::path &path, const std::vector<Mesh> &lods)
+{
+    if (lods.empty())
+    {
+        throw std::runtime_error("No LODs to write to " + path.string());
+    }
+    auto aligned = [](uint64_t offset) { return (offset + MESH_FILE_ALIGNMENT - 1) & ~(MESH_FILE_ALIGNMENT - 1); };
+
+    std::vector<MeshFileLod> lod_table;
+    uint64_t vertex_count{0};
+    uint64_t index_count{0};
+    for (const auto &lod : lods)
+    {
+        lod_table.push_back(MeshFileLod{static_cast<uint32_t>(vertex_count), static_cast<uint32_t>(lod.vertices.size()), static_cast<uint32_t>(index_count), static_cast<uint32_t>(lod.indices.size())});
+        vertex_count += lod.vertices.size();
+        index_count += lod.indices.size();
+    }
+
+    Bounds bounds = get_mesh_bounds(lods[0]);
+    MeshFileHeader header{};
+    header.magic = MESH_FILE_MAGIC;
+    header.version = MESH_FILE_VERSION;
+    header.vertex_stride = sizeof(Vertex);
+    header.lod_count = static_cast<uint32_t>(lods.size());
+    header.vertex_offset = aligned(sizeof(MeshFileHeader));
+    header.vertex_count = vertex_count;
+    header.index_offset = aligned(header.vertex_offset + vertex_count * sizeof(Vertex));
+    header.index_count = index_count;
+    header.lod_offset = aligned(header.index_offset + index_count * sizeof(uint32_t));
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        header.bounds_min[i] = bounds.min[i];
+        header.bounds_max[i] = bounds.max[i];
+        header.color[i] = lods[0].color[i];
+    }
+
+    bool written = write_file_atomically(path, [&](std::ostream &file)
+    {
+        auto pad_to = [&file](uint64_t offset)
+        {
+            static const char zeros[MESH_FILE_ALIGNMENT]{};
+            file.write(zeros, static_cast<std::streamsize>(offset - static_cast<uint64_t>(file.tellp())));
+        };
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        pad_to(header.vertex_offset);
+        for (const auto &lod : lods)
+        {
+            file.write(reinterpret_cast<const char *>(lod.vertices.data()), static_cast<std::streamsize>(lod.vertices.size() * sizeof(Vertex)));
+        }
+        pad_to(header.index_offset);
+        for (const auto &lod : lods)
+        {
+            file.write(reinterpret_cast<const char *>(lod.indices.data()), static_cast<std::streamsize>(lod.indices.size() * sizeof(int32_t)));
+        }
+        pad_to(header.lod_offset);
+        file.write(reinterpret_cast<const char *>(lod_table.data()), static_cast<std::streamsize>(lod_table.size() * sizeof(MeshFileLod)));
+    });
+    if (!written)
+    {
+        throw std::runtime_error("Failed to write " + path.string());
+    }
+}
+
+// Mapped baked mesh. Nothing is parsed or copied, the accessors point into the mapping, which stays valid
+// for the lifetime of the object (also across moves).
+class MeshFile
+{
+public:
+    MeshFile() = default;
+    explicit MeshFile(const std::filesystem::path &path) : file{path}
+    {
+        // Validation reads the whole index stream, the read ahead starts before it.
+        file.prefetch();
+        validate(path);
+    };
+
+    const MeshFileHeader &get_header() const
+    {
+        return *reinterpret_cast<const MeshFileHeader *>(file.data());
+    };
+
+    uint32_t get_lod_count() const
+    {
+        return get_header().lod_count;
+    };
+
+    const MeshFileLod &get_lod(uint32_t lod) const
+    {
+        return reinterpret_cast<const MeshFileLod *>(file.data() + get_header().lod_offset)[lod];
+    };
+
+    const Vertex *get_vertices(uint32_t lod) const
+    {
+        return reinterpret_cast<const Vertex *>(file.data() + get_header().vertex_offset) + get_lod(lod).first_vertex;
+    };
+
+    const uint32_t *get_indices(uint32_t lod) const
+    {
+        return reinterpret_cast<const uint32_t *>(file.data() + get_header().index_offset) + get_lod(lod).first_index;
+    };
+
+    Bounds get_bounds() const
+    {
+        const MeshFileHeader &header = get_header();
+        return Bounds{glm::vec3(header.bounds_min[0], header.bounds_min[1], header.bounds_min[2]), glm::vec3(header.bounds_max[0], header.bounds_max[1], header.bounds_max[2])};
+    };
+
+    glm::vec3 get_color() const
+    {
+        const MeshFileHeader &header = get_header();
+        return glm::vec3(header.color[0], header.color[1], header.color[2]);
+    };
+
+private:
+    MappedFile file;
+
+    // Checks everything the accessors and the draws rely on, so a truncated, stale or corrupt file fails here
+    // and not in the driver.
+    void validate(const std::filesystem::path &path) const
+    {
+        auto fail = [&path](const std::string &reason) { throw std::runtime_error("Invalid mesh file " + path.string() + ": " + reason); };
+        auto section_fits = [this](uint64_t offset, uint64_t count, uint64_t stride)
+        {
+            return offset % MESH_FILE_ALIGNMENT == 0 && offset <= file.size() && count <= (file.size() - offset) / stride;
+        };
+
+        if (file.size() < sizeof(MeshFileHeader))
+        {
+            fail("too small");
+        }
+        const MeshFileHeader &header = get_header();
+        if (header.magic != MESH_FILE_MAGIC)
+        {
+            fail("bad magic");
+        }
+        if (header.version != MESH_FILE_VERSION || header.vertex_stride != sizeof(Vertex))
+        {
+            fail("version " + std::to_string(header.version) + ", expected " + std::to_string(MESH_FILE_VERSION));
+        }
+        if (!section_fits(header.vertex_offset, header.vertex_count, sizeof(Vertex)) ||
+            !section_fits(header.index_offset, header.index_count, sizeof(uint32_t)) ||
+            !section_fits(header.lod_offset, header.lod_count, sizeof(MeshFileLod)))
+        {
+            fail("section out of range");
+        }
+        for (uint32_t i = 0; i < header.lod_count; i++)
+        {
+            const MeshFileLod &lod = get_lod(i);
+            if (static_cast<uint64_t>(lod.first_vertex) + lod.vertex_count > header.vertex_count ||
+                static_cast<uint64_t>(lod.first_index) + lod.index_count > header.index_count)
+            {
+                fail("LOD " + std::to_string(i) + " out of range");
+            }
+            // Indices address the LOD's own vertices, a larger one would be fetched out of bounds.
+            const uint32_t *indices = get_indices(i);
+            uint32_t max_index{0};
+            for (uint32_t j = 0; j < lod.index_count; j++)
+            {
+                max_index = std::max(max_index, indices[j]);
+            }
+            if (lod.index_count > 0 && max_index >= lod.vertex_count)
+            {
+                fail("LOD " + std::to_string(i) + " index " + std::to_string(max_index) + " out of range");
+            }
+        }
+    };
+};
+
+#endif
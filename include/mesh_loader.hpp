@@ -0,0 +1,32 @@
+#ifndef MESH_LOADER_HPP
+#define MESH_LOADER_HPP
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+
+#include <glm/glm.hpp>
+
+#include "gltf_loader.hpp"
+#include "mesh.hpp"
+#include "obj_loader.hpp"
+
+// Loads a mesh file by extension: .obj, .gltf or .glb.
+inline Mesh load_mesh(const std::filesystem::path &path, const glm::vec3 &color)
+{
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (extension == ".obj")
+    {
+        return ObjLoader::load(path, color);
+    }
+    if (extension == ".gltf" || extension == ".glb")
+    {
+        return GltfLoader::load(path, color);
+    }
+    throw std::runtime_error("Unsupported mesh format " + path.string());
+}
+
+#endif
@@ -0,0 +1,508 @@
+#ifndef MESH_SIMPLIFIER_HPP
+#define MESH_SIMPLIFIER_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "mesh.hpp"
+#include "profiler.hpp"
+#include "thread_pool.hpp"
+
+// Quadric error metric edge collapse simplifier. Vertices sharing a position are collapsed together, every
+// collapse moves one position onto a neighbouring one, so the result only uses vertices of the input and
+// keeps their normals. Corners that move pick the wedge of the target position whose normal is closest to
+// their own, which keeps hard edges, and collapses that turn a triangle too far are rejected.
+class MeshSimplifier
+{
+public:
+    // Relative error that lets the triangle target alone decide how far a LOD goes.
+    static constexpr float NO_ERROR_LIMIT{1.0f};
+
+    // Removes triangles until target_triangles is reached or the next collapse would move the surface by
+    // more than target_error, a fraction of the mesh's largest extent. Border vertices stay in place unless
+    // lock_border is off, then they only slide along the border. result_error receives the error reached.
+    static Mesh simplify(const Mesh &mesh, size_t target_triangles, float target_error, bool lock_border = true, float *result_error = nullptr)
+    {
+        PROFILE_FUNCTION();
+        MeshSimplifier simplifier{mesh, lock_border};
+        float error = simplifier.run(target_triangles, target_error);
+        if (result_error != nullptr)
+        {
+            *result_error = error;
+        }
+        return simplifier.build_result();
+    };
+
+    // lod_count levels, finest first, each with ratio times the triangles of the one before. Level 0 is the
+    // mesh itself, the others are simplified from it in parallel on the thread pool.
+    static std::vector<Mesh> build_lod_chain(const Mesh &mesh, uint32_t lod_count, float ratio = 0.5f, float max_error = NO_ERROR_LIMIT)
+    {
+        PROFILE_FUNCTION();
+        std::vector<Mesh> lods(std::max<uint32_t>(lod_count, 1));
+        lods[0] = mesh;
+        size_t triangle_count = mesh.indices.size() / 3;
+        ThreadPool::get().parallel_for(lods.size() - 1, 1, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; i++)
+            {
+                size_t target = static_cast<size_t>(triangle_count * std::pow(ratio, static_cast<float>(i + 1)));
+                lods[i + 1] = simplify(mesh, target, max_error);
+            }
+        });
+        return lods;
+    };
+
+private:
+    enum VertexKind : uint8_t
+    {
+        MANIFOLD,
+        BORDER,
+        LOCKED,
+    };
+
+    // Sum of squared distances to a set of weighted planes, A = n n^T, b = d n, c = d^2.
+    struct Quadric
+    {
+        double a00, a01, a02, a11, a12, a22;
+        double b0, b1, b2;
+        double c;
+        double weight;
+    };
+
+    struct Edge
+    {
+        uint64_t key;
+        uint8_t forward;
+    };
+
+    struct Collapse
+    {
+        uint32_t from;
+        uint32_t to;
+        float error;
+    };
+
+    // Face normals may turn by at most acos(MIN_NORMAL_DOT) in one collapse.
+    static constexpr float MIN_NORMAL_DOT{0.2f};
+    // Border planes weigh this much more than surface planes, per unit of edge length.
+    static constexpr double BORDER_WEIGHT{10.0};
+
+    const Mesh &mesh;
+    bool lock_border;
+    // Position of every distinct vertex position, and the distinct position of every vertex.
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> position_id;
+    // Vertices of position p are wedges[wedge_offsets[p], wedge_offsets[p + 1]).
+    std::vector<uint32_t> wedges;
+    std::vector<uint32_t> wedge_offsets;
+    std::vector<Quadric> quadrics;
+    // Three vertex indices per live triangle.
+    std::vector<uint32_t> triangles;
+
+    MeshSimplifier(const Mesh &_mesh, bool _lock_border) : mesh{_mesh}, lock_border{_lock_border}
+    {
+        weld_positions();
+        triangles.reserve(mesh.indices.size());
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+        {
+            uint32_t a = static_cast<uint32_t>(mesh.indices[i]);
+            uint32_t b = static_cast<uint32_t>(mesh.indices[i + 1]);
+            uint32_t c = static_cast<uint32_t>(mesh.indices[i + 2]);
+            if (position_id[a] != position_id[b] && position_id[b] != position_id[c] && position_id[c] != position_id[a])
+            {
+                triangles.insert(triangles.end(), {a, b, c});
+            }
+        }
+
+        quadrics.assign(positions.size(), Quadric{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0});
+        for (size_t t = 0; t < triangles.size(); t += 3)
+        {
+            const glm::vec3 &a = positions[position_id[triangles[t]]];
+            glm::vec3 normal = glm::cross(positions[position_id[triangles[t + 1]]] - a, positions[position_id[triangles[t + 2]]] - a);
+            float length = glm::length(normal);
+            if (length > 0.0f)
+            {
+                Quadric plane = plane_quadric(normal / length, a, length * 0.5);
+                for (uint32_t corner = 0; corner < 3; corner++)
+                {
+                    add(quadrics[position_id[triangles[t + corner]]], plane);
+                }
+            }
+        }
+    };
+
+    // Sorting the vertices by position puts equal positions next to each other.
+    void weld_positions()
+    {
+        size_t vertex_count = mesh.vertices.size();
+        wedges.resize(vertex_count);
+        std::iota(wedges.begin(), wedges.end(), 0);
+        auto less = [this](uint32_t a, uint32_t b)
+        {
+            const glm::vec3 &p = mesh.vertices[a].position;
+            const glm::vec3 &q = mesh.vertices[b].position;
+            return p.x != q.x ? p.x < q.x : p.y != q.y ? p.y < q.y : p.z < q.z;
+        };
+        std::sort(wedges.begin(), wedges.end(), less);
+
+        position_id.resize(vertex_count);
+        for (size_t i = 0; i < vertex_count; i++)
+        {
+            if (i == 0 || less(wedges[i - 1], wedges[i]))
+            {
+                wedge_offsets.push_back(static_cast<uint32_t>(i));
+                positions.push_back(mesh.vertices[wedges[i]].position);
+            }
+            position_id[wedges[i]] = static_cast<uint32_t>(positions.size() - 1);
+        }
+        wedge_offsets.push_back(static_cast<uint32_t>(vertex_count));
+    };
+
+    static Quadric plane_quadric(const glm::vec3 &normal, const glm::vec3 &point, double weight)
+    {
+        double x = normal.x;
+        double y = normal.y;
+        double z = normal.z;
+        double d = -(x * point.x + y * point.y + z * point.z);
+        return Quadric{weight * x * x, weight * x * y, weight * x * z, weight * y * y, weight * y * z, weight * z * z,
+                       weight * d * x, weight * d * y, weight * d * z, weight * d * d, weight};
+    };
+
+    static void add(Quadric &q, const Quadric &r)
+    {
+        q.a00 += r.a00;
+        q.a01 += r.a01;
+        q.a02 += r.a02;
+        q.a11 += r.a11;
+        q.a12 += r.a12;
+        q.a22 += r.a22;
+        q.b0 += r.b0;
+        q.b1 += r.b1;
+        q.b2 += r.b2;
+        q.c += r.c;
+        q.weight += r.weight;
+    };
+
+    // Weighted mean squared distance of p to the quadric's planes.
+    static double evaluate(const Quadric &q, const glm::vec3 &p)
+    {
+        double x = p.x;
+        double y = p.y;
+        double z = p.z;
+        double error = q.a00 * x * x + q.a11 * y * y + q.a22 * z * z + 2.0 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z) +
+                       2.0 * (q.b0 * x + q.b1 * y + q.b2 * z) + q.c;
+        return q.weight > 0.0 ? std::max(error, 0.0) / q.weight : 0.0;
+    };
+
+    float run(size_t target_triangles, float target_error)
+    {
+        glm::vec3 extent{0.0f};
+        if (!positions.empty())
+        {
+            Bounds bounds = get_mesh_bounds(mesh);
+            extent = bounds.max - bounds.min;
+        }
+        float scale = std::max(extent.x, std::max(extent.y, extent.z));
+        if (scale <= 0.0f)
+        {
+            return 0.0f;
+        }
+        double error_limit = static_cast<double>(target_error) * scale * target_error * scale;
+        double max_error{0.0};
+
+        bool first_pass{true};
+        std::vector<uint32_t> remap(positions.size());
+        std::vector<uint8_t> used(positions.size());
+        while (triangles.size() / 3 > target_triangles)
+        {
+            std::vector<uint32_t> adjacency_offsets;
+            std::vector<uint32_t> adjacency;
+            build_adjacency(adjacency_offsets, adjacency);
+            std::vector<Edge> edges = build_edges();
+            std::vector<uint8_t> kinds = classify(edges, first_pass);
+            first_pass = false;
+            std::vector<Collapse> collapses = pick_collapses(edges, kinds);
+            std::sort(collapses.begin(), collapses.end(), [](const Collapse &a, const Collapse &b) { return a.error < b.error; });
+
+            std::iota(remap.begin(), remap.end(), 0);
+            std::fill(used.begin(), used.end(), 0);
+            size_t triangles_to_remove = triangles.size() / 3 - target_triangles;
+            size_t removed{0};
+            size_t collapsed{0};
+            for (const auto &collapse : collapses)
+            {
+                if (collapse.error > error_limit || removed >= triangles_to_remove)
+                {
+                    break;
+                }
+                if (used[collapse.from] || used[collapse.to] || flips(collapse, remap, adjacency_offsets, adjacency))
+                {
+                    continue;
+                }
+                for (uint32_t a = adjacency_offsets[collapse.from]; a < adjacency_offsets[collapse.from + 1]; a++)
+                {
+                    const uint32_t *corners = &triangles[adjacency[a] * 3];
+                    bool shared = position_id[corners[0]] == collapse.to || position_id[corners[1]] == collapse.to || position_id[corners[2]] == collapse.to;
+                    removed += shared ? 1 : 0;
+                }
+                remap[collapse.from] = collapse.to;
+                add(quadrics[collapse.to], quadrics[collapse.from]);
+                used[collapse.from] = 1;
+                used[collapse.to] = 1;
+                max_error = std::max(max_error, static_cast<double>(collapse.error));
+                collapsed++;
+            }
+            if (collapsed == 0)
+            {
+                break;
+            }
+            apply(remap);
+        }
+        return static_cast<float>(std::sqrt(max_error) / scale);
+    };
+
+    void build_adjacency(std::vector<uint32_t> &offsets, std::vector<uint32_t> &adjacency) const
+    {
+        offsets.assign(positions.size() + 1, 0);
+        for (uint32_t vertex : triangles)
+        {
+            offsets[position_id[vertex] + 1]++;
+        }
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+        adjacency.resize(triangles.size());
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < triangles.size(); i++)
+        {
+            adjacency[fill[position_id[triangles[i]]]++] = static_cast<uint32_t>(i / 3);
+        }
+    };
+
+    // Undirected position edges sorted by key, once per triangle side, forward when the side runs from
+    // the smaller to the larger position.
+    std::vector<Edge> build_edges() const
+    {
+        std::vector<Edge> edges;
+        edges.reserve(triangles.size());
+        for (size_t t = 0; t < triangles.size(); t += 3)
+        {
+            for (uint32_t corner = 0; corner < 3; corner++)
+            {
+                uint32_t a = position_id[triangles[t + corner]];
+                uint32_t b = position_id[triangles[t + (corner + 1) % 3]];
+                uint64_t key = (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+                edges.push_back(Edge{key, static_cast<uint8_t>(a < b ? 1 : 0)});
+            }
+        }
+        std::sort(edges.begin(), edges.end(), [](const Edge &a, const Edge &b) { return a.key < b.key; });
+        return edges;
+    };
+
+    // Interior edges have two opposite sides, border edges one, anything else is non-manifold and locks
+    // its vertices, as do vertices where more or less than two border edges meet.
+    std::vector<uint8_t> classify(const std::vector<Edge> &edges, bool add_border_planes)
+    {
+        std::vector<uint8_t> kinds(positions.size(), MANIFOLD);
+        std::vector<uint8_t> border_edges(positions.size(), 0);
+        for (size_t i = 0; i < edges.size();)
+        {
+            size_t j{i};
+            uint32_t forward{0};
+            for (; j < edges.size() && edges[j].key == edges[i].key; j++)
+            {
+                forward += edges[j].forward;
+            }
+            uint32_t a = static_cast<uint32_t>(edges[i].key >> 32);
+            uint32_t b = static_cast<uint32_t>(edges[i].key);
+            if (j - i == 1)
+            {
+                border_edges[a] = static_cast<uint8_t>(std::min(border_edges[a] + 1, 3));
+                border_edges[b] = static_cast<uint8_t>(std::min(border_edges[b] + 1, 3));
+            }
+            else if (j - i != 2 || forward != 1)
+            {
+                kinds[a] = LOCKED;
+                kinds[b] = LOCKED;
+            }
+            i = j;
+        }
+        for (size_t p = 0; p < positions.size(); p++)
+        {
+            if (border_edges[p] != 0 && kinds[p] != LOCKED)
+            {
+                kinds[p] = lock_border || border_edges[p] != 2 ? LOCKED : BORDER;
+            }
+        }
+        if (add_border_planes && !lock_border)
+        {
+            add_border_quadrics(edges);
+        }
+        return kinds;
+    };
+
+    // Planes through the border edges, perpendicular to their triangle, keep sliding border vertices on
+    // the border's line.
+    void add_border_quadrics(const std::vector<Edge> &edges)
+    {
+        for (size_t t = 0; t < triangles.size(); t += 3)
+        {
+            const glm::vec3 &p0 = positions[position_id[triangles[t]]];
+            glm::vec3 normal = glm::cross(positions[position_id[triangles[t + 1]]] - p0, positions[position_id[triangles[t + 2]]] - p0);
+            for (uint32_t corner = 0; corner < 3; corner++)
+            {
+                uint32_t a = position_id[triangles[t + corner]];
+                uint32_t b = position_id[triangles[t + (corner + 1) % 3]];
+                uint64_t key = (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+                auto range = std::equal_range(edges.begin(), edges.end(), Edge{key, 0}, [](const Edge &x, const Edge &y) { return x.key < y.key; });
+                if (range.second - range.first != 1)
+                {
+                    continue;
+                }
+                glm::vec3 edge = positions[b] - positions[a];
+                glm::vec3 plane_normal = glm::cross(edge, normal);
+                float length = glm::length(plane_normal);
+                if (length > 0.0f)
+                {
+                    Quadric plane = plane_quadric(plane_normal / length, positions[a], glm::length(edge) * BORDER_WEIGHT);
+                    add(quadrics[a], plane);
+                    add(quadrics[b], plane);
+                }
+            }
+        }
+    };
+
+    // The cheaper allowed direction of every edge. Manifold vertices collapse along any edge, border
+    // vertices only along border edges, locked vertices never.
+    std::vector<Collapse> pick_collapses(const std::vector<Edge> &edges, const std::vector<uint8_t> &kinds) const
+    {
+        std::vector<Collapse> collapses;
+        for (size_t i = 0; i < edges.size();)
+        {
+            size_t j{i};
+            while (j < edges.size() && edges[j].key == edges[i].key)
+            {
+                j++;
+            }
+            bool border_edge = j - i == 1;
+            uint32_t a = static_cast<uint32_t>(edges[i].key >> 32);
+            uint32_t b = static_cast<uint32_t>(edges[i].key);
+            i = j;
+
+            auto allowed = [&](uint32_t from)
+            {
+                return kinds[from] == MANIFOLD || (kinds[from] == BORDER && border_edge);
+            };
+            if (!allowed(a) && !allowed(b))
+            {
+                continue;
+            }
+            Quadric sum = quadrics[a];
+            add(sum, quadrics[b]);
+            double error_ab = allowed(a) ? evaluate(sum, positions[b]) : HUGE_VAL;
+            double error_ba = allowed(b) ? evaluate(sum, positions[a]) : HUGE_VAL;
+            collapses.push_back(error_ab <= error_ba ? Collapse{a, b, static_cast<float>(error_ab)} : Collapse{b, a, static_cast<float>(error_ba)});
+        }
+        return collapses;
+    };
+
+    // Whether moving from onto to turns one of the surviving triangles around from too far, including
+    // the collapses already made in this pass.
+    bool flips(const Collapse &collapse, const std::vector<uint32_t> &remap, const std::vector<uint32_t> &adjacency_offsets, const std::vector<uint32_t> &adjacency) const
+    {
+        for (uint32_t a = adjacency_offsets[collapse.from]; a < adjacency_offsets[collapse.from + 1]; a++)
+        {
+            const uint32_t *corners = &triangles[adjacency[a] * 3];
+            uint32_t ids[3]{remap[position_id[corners[0]]], remap[position_id[corners[1]]], remap[position_id[corners[2]]]};
+            if (ids[0] == collapse.to || ids[1] == collapse.to || ids[2] == collapse.to)
+            {
+                continue;
+            }
+            glm::vec3 before[3]{positions[ids[0]], positions[ids[1]], positions[ids[2]]};
+            glm::vec3 after[3]{before[0], before[1], before[2]};
+            for (uint32_t corner = 0; corner < 3; corner++)
+            {
+                if (ids[corner] == collapse.from)
+                {
+                    after[corner] = positions[collapse.to];
+                }
+            }
+            glm::vec3 old_normal = glm::cross(before[1] - before[0], before[2] - before[0]);
+            glm::vec3 new_normal = glm::cross(after[1] - after[0], after[2] - after[0]);
+            float lengths = glm::length(old_normal) * glm::length(new_normal);
+            if (lengths <= 0.0f || glm::dot(old_normal, new_normal) < MIN_NORMAL_DOT * lengths)
+            {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    // Moves the corners of collapsed positions to the target's closest wedge and drops the triangles that
+    // became degenerate.
+    void apply(const std::vector<uint32_t> &remap)
+    {
+        size_t output{0};
+        for (size_t t = 0; t < triangles.size(); t += 3)
+        {
+            uint32_t corners[3];
+            for (uint32_t corner = 0; corner < 3; corner++)
+            {
+                uint32_t vertex = triangles[t + corner];
+                uint32_t target = remap[position_id[vertex]];
+                if (target != position_id[vertex])
+                {
+                    const glm::vec3 &normal = mesh.vertices[vertex].normal;
+                    float best_dot{-2.0f};
+                    for (uint32_t w = wedge_offsets[target]; w < wedge_offsets[target + 1]; w++)
+                    {
+                        float dot = glm::dot(normal, mesh.vertices[wedges[w]].normal);
+                        if (dot > best_dot)
+                        {
+                            best_dot = dot;
+                            vertex = wedges[w];
+                        }
+                    }
+                }
+                corners[corner] = vertex;
+            }
+            if (position_id[corners[0]] != position_id[corners[1]] && position_id[corners[1]] != position_id[corners[2]] && position_id[corners[2]] != position_id[corners[0]])
+            {
+                std::copy(corners, corners + 3, triangles.begin() + output);
+                output += 3;
+            }
+        }
+        triangles.resize(output);
+    };
+
+    // Keeps the referenced vertices in their original order.
+    Mesh build_result() const
+    {
+        Mesh result;
+        result.color = mesh.color;
+        std::vector<int32_t> new_index(mesh.vertices.size(), -1);
+        for (uint32_t vertex : triangles)
+        {
+            new_index[vertex] = 0;
+        }
+        for (size_t i = 0; i < mesh.vertices.size(); i++)
+        {
+            if (new_index[i] == 0)
+            {
+                new_index[i] = static_cast<int32_t>(result.vertices.size());
+                result.vertices.push_back(mesh.vertices[i]);
+            }
+        }
+        result.indices.reserve(triangles.size());
+        for (uint32_t vertex : triangles)
+        {
+            result.indices.push_back(new_index[vertex]);
+        }
+        return result;
+    };
+};
+
+#endif
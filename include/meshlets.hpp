@@ -0,0 +1,357 @@
+#ifndef MESHLETS_HPP
+#define MESHLETS_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "frame_arena.hpp"
+#include "mesh.hpp"
+#include "model.hpp"
+#include "profiler.hpp"
+
+// Small cluster of triangles that is culled as a whole. The bounding sphere and the normal cone are in
+// mesh space. cone_cutoff is the sine of the cone's half angle, above one the cone is too wide to cull.
+struct Meshlet
+{
+    uint32_t vertex_offset;
+    uint32_t vertex_count;
+    uint32_t triangle_offset;
+    uint32_t triangle_count;
+    glm::vec3 center;
+    float radius;
+    glm::vec3 cone_axis;
+    float cone_cutoff;
+};
+
+struct MeshletMesh
+{
+    std::vector<Meshlet> meshlets;
+    // Mesh vertex index of every meshlet local vertex.
+    std::vector<uint32_t> vertices;
+    // Three meshlet local vertex indices per triangle.
+    std::vector<uint8_t> triangles;
+};
+
+// Splits a mesh into meshlets of at most max_vertices vertices and max_triangles triangles. Each meshlet
+// grows from a seed triangle by adding the neighbouring triangle that brings in the fewest new vertices
+// and bends its normal cone the least, so meshlets stay compact and their cones narrow.
+class MeshletBuilder
+{
+public:
+    static constexpr uint32_t MAX_VERTICES{64};
+    static constexpr uint32_t MAX_TRIANGLES{124};
+
+    static MeshletMesh build(const Mesh &mesh, uint32_t max_vertices = MAX_VERTICES, uint32_t max_triangles = MAX_TRIANGLES)
+    {
+        PROFILE_FUNCTION();
+        max_vertices = std::clamp<uint32_t>(max_vertices, 3, 256);
+        max_triangles = std::max<uint32_t>(max_triangles, 1);
+        const size_t triangle_count = mesh.indices.size() / 3;
+        const size_t vertex_count = mesh.vertices.size();
+
+        // Triangles around every vertex, in compressed rows.
+        std::vector<uint32_t> adjacency_offsets(vertex_count + 1, 0);
+        for (int32_t index : mesh.indices)
+        {
+            adjacency_offsets[index + 1]++;
+        }
+        for (size_t i = 0; i < vertex_count; i++)
+        {
+            adjacency_offsets[i + 1] += adjacency_offsets[i];
+        }
+        std::vector<uint32_t> adjacency(mesh.indices.size());
+        std::vector<uint32_t> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+        for (size_t i = 0; i < mesh.indices.size(); i++)
+        {
+            adjacency[fill[mesh.indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+
+        std::vector<glm::vec3> normals(triangle_count);
+        for (size_t t = 0; t < triangle_count; t++)
+        {
+            normals[t] = triangle_normal(mesh, t);
+        }
+
+        MeshletMesh result;
+        std::vector<uint8_t> emitted(triangle_count, 0);
+        std::vector<int32_t> local_index(vertex_count, -1);
+        size_t next_seed{0};
+        while (true)
+        {
+            while (next_seed < triangle_count && emitted[next_seed])
+            {
+                next_seed++;
+            }
+            if (next_seed == triangle_count)
+            {
+                break;
+            }
+
+            Meshlet meshlet{static_cast<uint32_t>(result.vertices.size()), 0, static_cast<uint32_t>(result.triangles.size() / 3), 0, {}, 0.0f, {}, 0.0f};
+            glm::vec3 normal_sum{0.0f};
+            size_t triangle = next_seed;
+            while (true)
+            {
+                emitted[triangle] = 1;
+                normal_sum += normals[triangle];
+                for (uint32_t corner = 0; corner < 3; corner++)
+                {
+                    uint32_t vertex = static_cast<uint32_t>(mesh.indices[triangle * 3 + corner]);
+                    if (local_index[vertex] < 0)
+                    {
+                        local_index[vertex] = static_cast<int32_t>(meshlet.vertex_count++);
+                        result.vertices.push_back(vertex);
+                    }
+                    result.triangles.push_back(static_cast<uint8_t>(local_index[vertex]));
+                }
+                meshlet.triangle_count++;
+                if (meshlet.triangle_count == max_triangles)
+                {
+                    break;
+                }
+
+                // Best unemitted neighbour, fewest new vertices first, then closest to the current cone axis.
+                glm::vec3 axis = glm::length(normal_sum) > 0.0f ? glm::normalize(normal_sum) : glm::vec3(0.0f);
+                float best_score{std::numeric_limits<float>::max()};
+                size_t best{triangle_count};
+                for (uint32_t i = meshlet.vertex_offset; i < result.vertices.size(); i++)
+                {
+                    uint32_t vertex = result.vertices[i];
+                    for (uint32_t a = adjacency_offsets[vertex]; a < adjacency_offsets[vertex + 1]; a++)
+                    {
+                        uint32_t candidate = adjacency[a];
+                        if (emitted[candidate])
+                        {
+                            continue;
+                        }
+                        uint32_t new_vertices{0};
+                        for (uint32_t corner = 0; corner < 3; corner++)
+                        {
+                            new_vertices += local_index[mesh.indices[candidate * 3 + corner]] < 0 ? 1 : 0;
+                        }
+                        if (meshlet.vertex_count + new_vertices > max_vertices)
+                        {
+                            continue;
+                        }
+                        float score = new_vertices + CONE_WEIGHT * (1.0f - glm::dot(axis, normals[candidate]));
+                        if (score < best_score)
+                        {
+                            best_score = score;
+                            best = candidate;
+                        }
+                    }
+                }
+                if (best == triangle_count)
+                {
+                    break;
+                }
+                triangle = best;
+            }
+
+            for (uint32_t i = meshlet.vertex_offset; i < result.vertices.size(); i++)
+            {
+                local_index[result.vertices[i]] = -1;
+            }
+            compute_bounds(mesh, result, meshlet);
+            result.meshlets.push_back(meshlet);
+        }
+        return result;
+    };
+
+private:
+    // How many new vertices one unit of normal deviation is worth when picking the next triangle.
+    static constexpr float CONE_WEIGHT{2.0f};
+    // Cones whose normals spread past this dot product cover (almost) a half space and are never culled.
+    static constexpr float MIN_CONE_DOT{0.1f};
+
+    static glm::vec3 triangle_normal(const Mesh &mesh, size_t triangle)
+    {
+        const glm::vec3 &a = mesh.vertices[mesh.indices[triangle * 3]].position;
+        const glm::vec3 &b = mesh.vertices[mesh.indices[triangle * 3 + 1]].position;
+        const glm::vec3 &c = mesh.vertices[mesh.indices[triangle * 3 + 2]].position;
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float length = glm::length(normal);
+        return length > 0.0f ? normal / length : glm::vec3(0.0f);
+    };
+
+    static void compute_bounds(const Mesh &mesh, const MeshletMesh &result, Meshlet &meshlet)
+    {
+        glm::vec3 min{std::numeric_limits<float>::max()};
+        glm::vec3 max{std::numeric_limits<float>::lowest()};
+        for (uint32_t i = 0; i < meshlet.vertex_count; i++)
+        {
+            const glm::vec3 &position = mesh.vertices[result.vertices[meshlet.vertex_offset + i]].position;
+            min = glm::min(min, position);
+            max = glm::max(max, position);
+        }
+        meshlet.center = (min + max) * 0.5f;
+        meshlet.radius = 0.0f;
+        for (uint32_t i = 0; i < meshlet.vertex_count; i++)
+        {
+            meshlet.radius = std::max(meshlet.radius, glm::length(mesh.vertices[result.vertices[meshlet.vertex_offset + i]].position - meshlet.center));
+        }
+
+        glm::vec3 normal_sum{0.0f};
+        std::vector<glm::vec3> meshlet_normals;
+        meshlet_normals.reserve(meshlet.triangle_count);
+        for (uint32_t t = 0; t < meshlet.triangle_count; t++)
+        {
+            const uint8_t *corners = &result.triangles[(meshlet.triangle_offset + t) * 3];
+            glm::vec3 a = mesh.vertices[result.vertices[meshlet.vertex_offset + corners[0]]].position;
+            glm::vec3 b = mesh.vertices[result.vertices[meshlet.vertex_offset + corners[1]]].position;
+            glm::vec3 c = mesh.vertices[result.vertices[meshlet.vertex_offset + corners[2]]].position;
+            glm::vec3 normal = glm::cross(b - a, c - a);
+            float length = glm::length(normal);
+            if (length > 0.0f)
+            {
+                meshlet_normals.push_back(normal / length);
+                normal_sum += normal / length;
+            }
+        }
+
+        float axis_length = glm::length(normal_sum);
+        meshlet.cone_axis = axis_length > 0.0f ? normal_sum / axis_length : glm::vec3(0.0f, 0.0f, 1.0f);
+        float min_dot{1.0f};
+        for (const auto &normal : meshlet_normals)
+        {
+            min_dot = std::min(min_dot, glm::dot(meshlet.cone_axis, normal));
+        }
+        meshlet.cone_cutoff = axis_length > 0.0f && min_dot > MIN_CONE_DOT ? std::sqrt(1.0f - min_dot * min_dot) : 2.0f;
+    };
+};
+
+// Indexed drawable split into meshlets. Every draw culls whole meshlets against its view and projection,
+// outside the frustum or facing away from the camera, and submits the surviving index ranges with one
+// glMultiDrawElements. The cone test assumes rotation and uniform scale in the model matrix. Passes that
+// do not look through the camera, such as shadow maps, must turn culling off for their draws.
+class MeshletModel : public Drawable
+{
+private:
+    MeshletMesh meshlets;
+    uint32_t EBO;
+    // First index and index count of every meshlet in the index buffer.
+    std::vector<uint32_t> meshlet_first_index;
+    bool culling_enabled{true};
+    uint32_t drawn{0};
+
+    void create_buffers() override
+    {
+        Drawable::create_buffers();
+
+        // Meshlets are laid out one after the other, so neighbouring visible meshlets merge into one range.
+        std::vector<uint32_t> indices;
+        indices.reserve(meshlets.triangles.size());
+        for (const auto &meshlet : meshlets.meshlets)
+        {
+            meshlet_first_index.push_back(static_cast<uint32_t>(indices.size()));
+            for (uint32_t i = 0; i < meshlet.triangle_count * 3; i++)
+            {
+                indices.push_back(meshlets.vertices[meshlet.vertex_offset + meshlets.triangles[meshlet.triangle_offset * 3 + i]]);
+            }
+        }
+        meshlet_first_index.push_back(static_cast<uint32_t>(indices.size()));
+
+        glGenBuffers(1, &EBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * indices.size(), indices.data(), GL_STATIC_DRAW);
+    };
+
+    bool is_visible(const Meshlet &meshlet, const glm::vec4 (&planes)[6], const glm::vec3 &camera) const
+    {
+        for (const auto &plane : planes)
+        {
+            if (glm::dot(glm::vec3(plane), meshlet.center) + plane.w < -meshlet.radius)
+            {
+                return false;
+            }
+        }
+        glm::vec3 to_center = meshlet.center - camera;
+        return glm::dot(to_center, meshlet.cone_axis) < meshlet.cone_cutoff * glm::length(to_center) + meshlet.radius;
+    };
+
+public:
+    MeshletModel(Mesh&& mesh, const Transform& transform, const glm::mat4& view, const glm::mat4& projection, MeshResidency residency = MeshResidency::bounds_only)
+        : Drawable{std::move(mesh), transform, view, projection, residency}, meshlets{MeshletBuilder::build(get_mesh())}
+    {
+        create_buffers();
+        release_mesh();
+    };
+    MeshletModel(const Mesh& mesh, const Transform& transform, const glm::mat4& view, const glm::mat4& projection, MeshResidency residency = MeshResidency::bounds_only)
+        : MeshletModel{Mesh{mesh}, transform, view, projection, residency} {};
+    MeshletModel(const MeshletModel&) = delete;
+    MeshletModel& operator=(const MeshletModel&) = delete;
+    ~MeshletModel() override
+    {
+        glDeleteBuffers(1, &EBO);
+    };
+
+    void set_culling(bool enabled)
+    {
+        culling_enabled = enabled;
+    };
+
+    uint32_t meshlet_count() const { return static_cast<uint32_t>(meshlets.meshlets.size()); };
+    // Meshlets submitted by the last draw.
+    uint32_t drawn_count() const { return drawn; };
+
+    void draw(Shader& shader) override
+    {
+        glBindVertexArray(VAO);
+        shader.use();
+        set_transform(shader);
+
+        // Planes and camera in mesh space, so the meshlet bounds are used as they are.
+        glm::mat4 model_view_projection = projection * view * model;
+        glm::vec4 planes[6];
+        for (int i = 0; i < 3; i++)
+        {
+            glm::vec4 row{model_view_projection[0][i], model_view_projection[1][i], model_view_projection[2][i], model_view_projection[3][i]};
+            glm::vec4 last{model_view_projection[0][3], model_view_projection[1][3], model_view_projection[2][3], model_view_projection[3][3]};
+            planes[i * 2] = last + row;
+            planes[i * 2 + 1] = last - row;
+        }
+        for (auto &plane : planes)
+        {
+            plane /= glm::length(glm::vec3(plane));
+        }
+        glm::vec3 camera = glm::vec3(glm::inverse(view * model)[3]);
+
+        FrameVector<int32_t> draw_counts{FrameArena::get().allocator<int32_t>()};
+        FrameVector<const void *> draw_offsets{FrameArena::get().allocator<const void *>()};
+        draw_counts.reserve(meshlets.meshlets.size());
+        draw_offsets.reserve(meshlets.meshlets.size());
+        drawn = 0;
+        bool previous_visible{false};
+        for (size_t i = 0; i < meshlets.meshlets.size(); i++)
+        {
+            bool visible = !culling_enabled || is_visible(meshlets.meshlets[i], planes, camera);
+            if (visible)
+            {
+                int32_t count = static_cast<int32_t>(meshlet_first_index[i + 1] - meshlet_first_index[i]);
+                if (previous_visible)
+                {
+                    draw_counts.back() += count;
+                }
+                else
+                {
+                    draw_counts.push_back(count);
+                    draw_offsets.push_back(reinterpret_cast<const void *>(sizeof(uint32_t) * meshlet_first_index[i]));
+                }
+                drawn++;
+            }
+            previous_visible = visible;
+        }
+        if (!draw_counts.empty())
+        {
+            glMultiDrawElements(GL_TRIANGLES, draw_counts.data(), GL_UNSIGNED_INT, draw_offsets.data(), static_cast<int32_t>(draw_counts.size()));
+        }
+    };
+};
+
+#endif
@@ -2,34 +2,70 @@
 #define MODEL_HPP
 
 #include <cstdint>
+#include <utility>
+#include <vector>
 
 #include <glad/glad.h>
 #include <glm/mat4x4.hpp>
 
 #include "shader.hpp"
 #include "mesh.hpp"
+#include "mesh_file.hpp"
 #include "transform.hpp"
 
+// What a drawable keeps of its Mesh once the geometry is on the GPU. Only drawables read on the CPU
+// afterwards, such as occluders, need to keep the vertices and indices.
+enum class MeshResidency
+{
+    // Vertices and indices stay in memory.
+    keep,
+    // Vertices and indices are freed after upload, the bounds stay for culling.
+    bounds_only,
+    // Like bounds_only, but the bounds are not computed either, for drawables that are never culled.
+    discard,
+};
+
 class Drawable
 {
 protected:
     Mesh mesh;
+    Bounds bounds;
     Transform transform;
+    MeshResidency residency{MeshResidency::keep};
     uint32_t VAO;
     uint32_t VBO;
+    // Element counts of the uploaded geometry, valid whatever the residency.
+    uint32_t vertex_count{0};
+    uint32_t index_count{0};
 
     glm::mat4 model;
     glm::mat4 view;
     glm::mat4 projection;
 
     virtual void create_buffers()
+    {
+        vertex_count = static_cast<uint32_t>(mesh.vertices.size());
+        index_count = static_cast<uint32_t>(mesh.indices.size());
+        create_vertex_buffer(mesh.vertices.data(), sizeof(Vertex) * mesh.vertices.size());
+    };
+    // Called by the final class once everything is uploaded. Assigning empty vectors frees their memory,
+    // clear() would keep the capacity.
+    void release_mesh()
+    {
+        if (residency != MeshResidency::keep)
+        {
+            mesh.vertices = std::vector<Vertex>{};
+            mesh.indices = std::vector<int32_t>{};
+        }
+    };
+    void create_vertex_buffer(const void *vertices, size_t size)
     {
         glGenVertexArrays(1, &VAO);
         glBindVertexArray(VAO);
 
         glGenBuffers(1, &VBO);
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * mesh.vertices.size(), mesh.vertices.data(), GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, size, vertices, GL_STATIC_DRAW);
 
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 6, (void *)(0));
         glEnableVertexAttribArray(0);
@@ -45,8 +81,22 @@ protected:
     };
 public:
     Drawable() = default;
-    Drawable(const Mesh& _mesh, const Transform& _transform, const glm::mat4& _view, const glm::mat4& _projection) : mesh{_mesh}, transform{_transform}, view{_view}, projection{_projection}
+    Drawable(Mesh&& _mesh, const Transform& _transform, const glm::mat4& _view, const glm::mat4& _projection, MeshResidency _residency)
+        : mesh{std::move(_mesh)}, bounds{Bounds{glm::vec3(0.0f), glm::vec3(0.0f)}}, transform{_transform}, residency{_residency}, view{_view}, projection{_projection}
     {
+        if (residency != MeshResidency::discard)
+        {
+            bounds = get_mesh_bounds(mesh);
+        }
+        model = glm::translate(glm::mat4(1.0f), transform.translate);
+        model = glm::rotate(model, transform.angle, transform.rotate_axis);
+        model = glm::scale(model, transform.scale);
+    };
+    // For drawables without a CPU side copy of the geometry, get_mesh() then only carries the color.
+    Drawable(const Bounds& _bounds, const glm::vec3& color, const Transform& _transform, const glm::mat4& _view, const glm::mat4& _projection)
+        : bounds{_bounds}, transform{_transform}, residency{MeshResidency::bounds_only}, view{_view}, projection{_projection}
+    {
+        mesh.color = color;
         model = glm::translate(glm::mat4(1.0f), transform.translate);
         model = glm::rotate(model, transform.angle, transform.rotate_axis);
         model = glm::scale(model, transform.scale);
@@ -61,6 +111,23 @@ public:
     {
         return transform;
     };
+    const glm::mat4& get_model() const
+    {
+        return model;
+    };
+    // Vertices and indices are only there with MeshResidency::keep.
+    const Mesh& get_mesh() const
+    {
+        return mesh;
+    };
+    MeshResidency get_residency() const
+    {
+        return residency;
+    };
+    const Bounds& get_bounds() const
+    {
+        return bounds;
+    };
     void update_transform(const Transform& _transform)
     {
         transform = _transform;
@@ -90,16 +157,23 @@ class Model : public Drawable
 {
 public:
     Model() = default;
-    Model(const Mesh& mesh, const Transform& transform, const glm::mat4& view, const glm::mat4& projection) : Drawable{mesh, transform, view, projection}
+    Model(Mesh&& mesh, const Transform& transform, const glm::mat4& view, const glm::mat4& projection, MeshResidency residency = MeshResidency::bounds_only)
+        : Drawable{std::move(mesh), transform, view, projection, residency}
     {
         create_buffers();
+        release_mesh();
     };
+    Model(const Mesh& mesh, const Transform& transform, const glm::mat4& view, const glm::mat4& projection, MeshResidency residency = MeshResidency::bounds_only)
+        : Model{Mesh{mesh}, transform, view, projection, residency} {};
     Model(const Model&) = delete;
     Model(Model&& model)
     {
         std::swap(mesh, model.mesh);
+        std::swap(bounds, model.bounds);
         std::swap(VAO, model.VAO);
         std::swap(VBO, model.VBO);
+        std::swap(vertex_count, model.vertex_count);
+        std::swap(residency, model.residency);
         std::swap(transform, model.transform);
     }
     ~Model() override {};
@@ -113,8 +187,11 @@ public:
         }
 
         std::swap(mesh, model.mesh);
+        std::swap(bounds, model.bounds);
         std::swap(VAO, model.VAO);
         std::swap(VBO, model.VBO);
+        std::swap(vertex_count, model.vertex_count);
+        std::swap(residency, model.residency);
         std::swap(transform, model.transform);
 
         return *this;
@@ -125,7 +202,7 @@ public:
         set_transform(shader);
         glBindVertexArray(VAO);
         shader.use();
-        glDrawArrays(GL_TRIANGLES, 0, mesh.vertices.size());
+        glDrawArrays(GL_TRIANGLES, 0, static_cast<int32_t>(vertex_count));
     };
 };
 
@@ -144,17 +221,25 @@ private:
     };
 public:
     ModelIndexed() = default;
-    ModelIndexed(const Mesh& mesh, const Transform& transform, const glm::mat4& view, const glm::mat4& projection) : Drawable{mesh, transform, view, projection}
+    ModelIndexed(Mesh&& mesh, const Transform& transform, const glm::mat4& view, const glm::mat4& projection, MeshResidency residency = MeshResidency::bounds_only)
+        : Drawable{std::move(mesh), transform, view, projection, residency}
     {
         create_buffers();
+        release_mesh();
     };
+    ModelIndexed(const Mesh& mesh, const Transform& transform, const glm::mat4& view, const glm::mat4& projection, MeshResidency residency = MeshResidency::bounds_only)
+        : ModelIndexed{Mesh{mesh}, transform, view, projection, residency} {};
     ModelIndexed(const ModelIndexed&) = delete;
     ModelIndexed(ModelIndexed&& model)
     {
         std::swap(mesh, model.mesh);
+        std::swap(bounds, model.bounds);
         std::swap(VAO, model.VAO);
         std::swap(VBO, model.VBO);
         std::swap(EBO, model.EBO);
+        std::swap(vertex_count, model.vertex_count);
+        std::swap(index_count, model.index_count);
+        std::swap(residency, model.residency);
         std::swap(transform, model.transform);
     }
     ~ModelIndexed() override
@@ -171,9 +256,85 @@ public:
         }
 
         std::swap(mesh, model.mesh);
+        std::swap(bounds, model.bounds);
+        std::swap(VAO, model.VAO);
+        std::swap(VBO, model.VBO);
+        std::swap(EBO, model.EBO);
+        std::swap(vertex_count, model.vertex_count);
+        std::swap(index_count, model.index_count);
+        std::swap(residency, model.residency);
+        std::swap(transform, model.transform);
+
+        return *this;
+    };
+
+    void draw(Shader& shader) override
+    {
+        glBindVertexArray(VAO);
+        shader.use();
+        set_transform(shader);
+        glDrawElements(GL_TRIANGLES, static_cast<int32_t>(index_count), GL_UNSIGNED_INT, nullptr);
+    };
+};
+
+// One LOD of a baked mesh, uploaded straight from the mapped file pages. The driver reads the mapping
+// directly, so no Mesh is ever built and the geometry is not kept in memory once uploaded.
+class MeshFileModel : public Drawable
+{
+private:
+    uint32_t EBO;
+
+public:
+    MeshFileModel() = default;
+    MeshFileModel(const MeshFile& file, uint32_t lod, const Transform& transform, const glm::mat4& view, const glm::mat4& projection) : Drawable{file.get_bounds(), file.get_color(), transform, view, projection}
+    {
+        if (lod >= file.get_lod_count())
+        {
+            throw std::runtime_error("Mesh file has no LOD " + std::to_string(lod));
+        }
+        const MeshFileLod& range = file.get_lod(lod);
+        vertex_count = range.vertex_count;
+        index_count = range.index_count;
+        create_vertex_buffer(file.get_vertices(lod), sizeof(Vertex) * range.vertex_count);
+
+        glGenBuffers(1, &EBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * range.index_count, file.get_indices(lod), GL_STATIC_DRAW);
+    };
+    MeshFileModel(const MeshFileModel&) = delete;
+    MeshFileModel(MeshFileModel&& model)
+    {
+        std::swap(mesh, model.mesh);
+        std::swap(bounds, model.bounds);
+        std::swap(VAO, model.VAO);
+        std::swap(VBO, model.VBO);
+        std::swap(EBO, model.EBO);
+        std::swap(vertex_count, model.vertex_count);
+        std::swap(index_count, model.index_count);
+        std::swap(residency, model.residency);
+        std::swap(transform, model.transform);
+    }
+    ~MeshFileModel() override
+    {
+        glDeleteBuffers(1, &EBO);
+    };
+
+    MeshFileModel& operator=(const MeshFileModel&) = delete;
+    MeshFileModel& operator=(MeshFileModel&& model)
+    {
+        if (this == &model)
+        {
+            return *this;
+        }
+
+        std::swap(mesh, model.mesh);
+        std::swap(bounds, model.bounds);
         std::swap(VAO, model.VAO);
         std::swap(VBO, model.VBO);
         std::swap(EBO, model.EBO);
+        std::swap(vertex_count, model.vertex_count);
+        std::swap(index_count, model.index_count);
+        std::swap(residency, model.residency);
         std::swap(transform, model.transform);
 
         return *this;
@@ -184,7 +345,7 @@ public:
         glBindVertexArray(VAO);
         shader.use();
         set_transform(shader);
-        glDrawElements(GL_TRIANGLES, static_cast<int32_t>(mesh.indices.size()), GL_UNSIGNED_INT, nullptr);
+        glDrawElements(GL_TRIANGLES, static_cast<int32_t>(index_count), GL_UNSIGNED_INT, nullptr);
     };
 };
 
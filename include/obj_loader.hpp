@@ -0,0 +1,344 @@
+#ifndef OBJ_LOADER_HPP
+#define OBJ_LOADER_HPP
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "mapped_file.hpp"
+#include "mesh.hpp"
+#include "profiler.hpp"
+#include "thread_pool.hpp"
+
+// Wavefront OBJ reader for positions, normals and polygonal faces, everything else (texture coordinates,
+// groups, materials) is skipped. The mapped file is cut into chunks at line boundaries that are parsed in
+// parallel with std::from_chars, then the per chunk results are stitched together and corners sharing a
+// position and normal are merged into one indexed vertex.
+class ObjLoader
+{
+public:
+    static Mesh load(const std::filesystem::path &path, const glm::vec3 &color)
+    {
+        PROFILE_FUNCTION();
+        MappedFile file{path};
+        file.prefetch();
+        const char *text = reinterpret_cast<const char *>(file.data());
+        std::vector<Chunk> chunks = split(text, file.size());
+
+        ThreadPool::get().parallel_for(chunks.size(), 1, [&chunks](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; i++)
+            {
+                parse(chunks[i]);
+            }
+        });
+
+        // Negative indices count back from the current element, which needs the element counts of all
+        // earlier chunks, so they are resolved once every chunk is parsed.
+        size_t position_count{0};
+        size_t normal_count{0};
+        for (auto &chunk : chunks)
+        {
+            if (!chunk.error.empty())
+            {
+                throw std::runtime_error(path.string() + ": " + chunk.error);
+            }
+            chunk.first_position = position_count;
+            chunk.first_normal = normal_count;
+            position_count += chunk.positions.size();
+            normal_count += chunk.normals.size();
+        }
+        if (position_count > static_cast<size_t>(std::numeric_limits<int32_t>::max()))
+        {
+            throw std::runtime_error(path.string() + ": too many positions");
+        }
+
+        std::vector<glm::vec3> positions(position_count);
+        std::vector<glm::vec3> normals(normal_count);
+        ThreadPool::get().parallel_for(chunks.size(), 1, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; i++)
+            {
+                Chunk &chunk = chunks[i];
+                std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + chunk.first_position);
+                std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + chunk.first_normal);
+                resolve(chunk, position_count, normal_count);
+            }
+        });
+        for (const auto &chunk : chunks)
+        {
+            if (!chunk.error.empty())
+            {
+                throw std::runtime_error(path.string() + ": " + chunk.error);
+            }
+        }
+
+        return build_mesh(chunks, positions, normals, color);
+    };
+
+private:
+    // Minimum bytes per chunk, smaller files are not worth splitting.
+    static constexpr size_t MIN_CHUNK_SIZE{1 << 20};
+    // Marks a corner without a normal.
+    static constexpr int32_t NO_NORMAL{std::numeric_limits<int32_t>::min()};
+
+    // One triangle corner with zero based indices. Indices flagged relative are counted from the start of
+    // the chunk, and may be negative when they reach back into an earlier chunk, until resolve() makes them
+    // absolute.
+    struct Corner
+    {
+        int32_t position;
+        int32_t normal;
+        uint8_t relative;
+    };
+    static constexpr uint8_t RELATIVE_POSITION{1};
+    static constexpr uint8_t RELATIVE_NORMAL{2};
+
+    struct Chunk
+    {
+        const char *begin;
+        const char *end;
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec3> normals;
+        std::vector<Corner> corners;
+        size_t first_position{0};
+        size_t first_normal{0};
+        std::string error;
+    };
+
+    static std::vector<Chunk> split(const char *text, size_t size)
+    {
+        size_t chunk_count = std::clamp<size_t>(size / MIN_CHUNK_SIZE, 1, (ThreadPool::get().thread_count() + 1) * 4);
+        std::vector<Chunk> chunks;
+        const char *end = text + size;
+        const char *begin = text;
+        for (size_t i = 1; i <= chunk_count && begin < end; i++)
+        {
+            const char *split_point = i == chunk_count ? end : std::max(begin, text + size * i / chunk_count);
+            split_point = std::find(split_point, end, '\n');
+            split_point = split_point == end ? end : split_point + 1;
+            chunks.push_back(Chunk{begin, split_point, {}, {}, {}, 0, 0, {}});
+            begin = split_point;
+        }
+        return chunks;
+    };
+
+    static bool is_space(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    };
+
+    static void skip_spaces(const char *&cursor, const char *end)
+    {
+        while (cursor < end && is_space(*cursor))
+        {
+            cursor++;
+        }
+    };
+
+    static bool parse_float(const char *&cursor, const char *end, float &value)
+    {
+        skip_spaces(cursor, end);
+        // from_chars does not accept the explicit plus sign some exporters write.
+        if (cursor < end && *cursor == '+')
+        {
+            cursor++;
+        }
+        auto [next, error] = std::from_chars(cursor, end, value);
+        cursor = next;
+        return error == std::errc{};
+    };
+
+    static bool parse_vec3(const char *&cursor, const char *end, glm::vec3 &value)
+    {
+        return parse_float(cursor, end, value.x) && parse_float(cursor, end, value.y) && parse_float(cursor, end, value.z);
+    };
+
+    // OBJ indices are one based, negative ones are relative to the elements read so far.
+    static bool parse_index(const char *&cursor, const char *end, size_t local_count, int32_t &index, bool &relative)
+    {
+        int64_t value{0};
+        auto [next, error] = std::from_chars(cursor, end, value);
+        if (error != std::errc{} || value == 0 || value > std::numeric_limits<int32_t>::max() || value < -std::numeric_limits<int32_t>::max())
+        {
+            return false;
+        }
+        cursor = next;
+        relative = value < 0;
+        index = static_cast<int32_t>(relative ? static_cast<int64_t>(local_count) + value : value - 1);
+        return true;
+    };
+
+    static bool parse_corner(const char *&cursor, const char *end, const Chunk &chunk, Corner &corner)
+    {
+        bool relative{false};
+        corner = Corner{0, NO_NORMAL, 0};
+        if (!parse_index(cursor, end, chunk.positions.size(), corner.position, relative))
+        {
+            return false;
+        }
+        corner.relative = relative ? RELATIVE_POSITION : 0;
+        // v, v/vt, v//vn or v/vt/vn, the texture coordinate is skipped.
+        if (cursor < end && *cursor == '/')
+        {
+            cursor++;
+            while (cursor < end && *cursor != '/' && !is_space(*cursor) && *cursor != '\n')
+            {
+                cursor++;
+            }
+            if (cursor < end && *cursor == '/')
+            {
+                cursor++;
+                if (!parse_index(cursor, end, chunk.normals.size(), corner.normal, relative))
+                {
+                    return false;
+                }
+                corner.relative |= relative ? RELATIVE_NORMAL : 0;
+            }
+        }
+        return true;
+    };
+
+    static void parse(Chunk &chunk)
+    {
+        const char *cursor = chunk.begin;
+        const char *end = chunk.end;
+        std::vector<Corner> polygon;
+        while (cursor < end)
+        {
+            const char *line_begin = cursor;
+            const char *line_end = std::find(cursor, end, '\n');
+            skip_spaces(cursor, line_end);
+            bool valid{true};
+            if (line_end - cursor >= 2 && cursor[0] == 'v' && is_space(cursor[1]))
+            {
+                glm::vec3 position;
+                cursor += 1;
+                valid = parse_vec3(cursor, line_end, position);
+                chunk.positions.push_back(position);
+            }
+            else if (line_end - cursor >= 3 && cursor[0] == 'v' && cursor[1] == 'n' && is_space(cursor[2]))
+            {
+                glm::vec3 normal;
+                cursor += 2;
+                valid = parse_vec3(cursor, line_end, normal);
+                chunk.normals.push_back(normal);
+            }
+            else if (line_end - cursor >= 2 && cursor[0] == 'f' && is_space(cursor[1]))
+            {
+                cursor += 1;
+                polygon.clear();
+                skip_spaces(cursor, line_end);
+                while (valid && cursor < line_end)
+                {
+                    Corner corner;
+                    valid = parse_corner(cursor, line_end, chunk, corner);
+                    polygon.push_back(corner);
+                    skip_spaces(cursor, line_end);
+                }
+                valid = valid && polygon.size() >= 3;
+                // Fan triangulation, faces are expected to be convex.
+                for (size_t i = 2; valid && i < polygon.size(); i++)
+                {
+                    chunk.corners.push_back(polygon[0]);
+                    chunk.corners.push_back(polygon[i - 1]);
+                    chunk.corners.push_back(polygon[i]);
+                }
+            }
+            if (!valid)
+            {
+                // Chunks do not know their line numbers, the line itself is quoted instead.
+                chunk.error = "malformed line \"" + std::string(line_begin, std::min<size_t>(line_end - line_begin, 80)) + "\"";
+                return;
+            }
+            cursor = line_end == end ? end : line_end + 1;
+        }
+    };
+
+    static void resolve(Chunk &chunk, size_t position_count, size_t normal_count)
+    {
+        auto resolve_index = [](int32_t &index, bool relative, size_t first, size_t count)
+        {
+            int64_t absolute = relative ? static_cast<int64_t>(first) + index : index;
+            index = static_cast<int32_t>(absolute);
+            return absolute >= 0 && static_cast<size_t>(absolute) < count;
+        };
+        for (auto &corner : chunk.corners)
+        {
+            bool valid = resolve_index(corner.position, corner.relative & RELATIVE_POSITION, chunk.first_position, position_count);
+            if (corner.normal != NO_NORMAL)
+            {
+                valid = valid && resolve_index(corner.normal, corner.relative & RELATIVE_NORMAL, chunk.first_normal, normal_count);
+            }
+            if (!valid)
+            {
+                chunk.error = "face index out of range";
+                return;
+            }
+        }
+    };
+
+    // Merges corners with the same position and normal index. Vertices of one position are chained off
+    // that position, so the lookup touches a couple of entries instead of hashing every corner.
+    static Mesh build_mesh(const std::vector<Chunk> &chunks, const std::vector<glm::vec3> &positions, const std::vector<glm::vec3> &normals, const glm::vec3 &color)
+    {
+        PROFILE_FUNCTION();
+        constexpr uint32_t NONE{std::numeric_limits<uint32_t>::max()};
+        size_t corner_count{0};
+        for (const auto &chunk : chunks)
+        {
+            corner_count += chunk.corners.size();
+        }
+
+        Mesh mesh;
+        mesh.color = color;
+        mesh.indices.reserve(corner_count);
+        mesh.vertices.reserve(positions.size());
+        std::vector<uint32_t> first_vertex(positions.size(), NONE);
+        std::vector<uint32_t> next_vertex;
+        std::vector<int32_t> vertex_normal;
+        next_vertex.reserve(positions.size());
+        vertex_normal.reserve(positions.size());
+        std::vector<uint8_t> missing_normals;
+        missing_normals.reserve(positions.size());
+        bool any_missing{false};
+
+        for (const auto &chunk : chunks)
+        {
+            for (const auto &corner : chunk.corners)
+            {
+                uint32_t vertex = first_vertex[corner.position];
+                while (vertex != NONE && vertex_normal[vertex] != corner.normal)
+                {
+                    vertex = next_vertex[vertex];
+                }
+                if (vertex == NONE)
+                {
+                    vertex = static_cast<uint32_t>(mesh.vertices.size());
+                    bool has_normal = corner.normal != NO_NORMAL;
+                    mesh.vertices.push_back(Vertex{positions[corner.position], has_normal ? normals[corner.normal] : glm::vec3(0.0f)});
+                    next_vertex.push_back(first_vertex[corner.position]);
+                    vertex_normal.push_back(corner.normal);
+                    missing_normals.push_back(has_normal ? 0 : 1);
+                    any_missing = any_missing || !has_normal;
+                    first_vertex[corner.position] = vertex;
+                }
+                mesh.indices.push_back(static_cast<int32_t>(vertex));
+            }
+        }
+        if (any_missing)
+        {
+            generate_normals(mesh, missing_normals);
+        }
+        return mesh;
+    };
+};
+
+#endif
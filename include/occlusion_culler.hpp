@@ -0,0 +1,397 @@
+#ifndef OCCLUSION_CULLER_HPP
+#define OCCLUSION_CULLER_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define OCCLUSION_CULLER_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OCCLUSION_CULLER_SSE 1
+#endif
+
+#include <glm/glm.hpp>
+
+#include "frame_arena.hpp"
+#include "mesh.hpp"
+#include "model.hpp"
+#include "profiler.hpp"
+#include "thread_pool.hpp"
+
+// Masked software occlusion culling. Occluder triangles are rasterized at low resolution into 8x4 pixel
+// tiles. A tile does not store per pixel depth, it keeps a conservative far depth for the whole tile plus a
+// working layer: a coverage mask and the far depth of the covered part. Once the working layer covers the
+// whole tile it becomes the new far depth. Bounding boxes are then tested against the far depths. Rows of
+// tiles are split over the thread pool and every tile row is owned by one thread, so no locking is needed.
+// Build with ENABLE_AVX2 to evaluate a tile row of eight pixels per instruction, SSE2 does four and
+// other targets fall back to scalar code.
+class OcclusionCuller
+{
+public:
+    static constexpr uint32_t WIDTH{256};
+    static constexpr uint32_t HEIGHT{144};
+    static constexpr uint32_t TILE_WIDTH{8};
+    static constexpr uint32_t TILE_HEIGHT{4};
+    static constexpr uint32_t TILES_X{WIDTH / TILE_WIDTH};
+    static constexpr uint32_t TILES_Y{HEIGHT / TILE_HEIGHT};
+    static constexpr uint32_t FULL_MASK{0xFFFFFFFFu};
+    static_assert(TILE_WIDTH * TILE_HEIGHT == 32, "A tile's coverage must fit a 32 bit mask.");
+
+    // Clears the depth tiles and the occluder list for a new view.
+    void begin_frame(const glm::mat4 &_view_projection)
+    {
+        view_projection = _view_projection;
+        occluders.clear();
+        tiles.assign(TILES_X * TILES_Y, Tile{0, 1.0f, 0.0f});
+        tested = 0;
+        culled = 0;
+    };
+
+    // The drawable must stay alive until rasterize() returns and keep its mesh, see MeshResidency::keep.
+    void add_occluder(const Drawable &drawable)
+    {
+        occluders.push_back(&drawable);
+    };
+
+    void rasterize()
+    {
+        PROFILE_FUNCTION();
+        size_t triangle_count{0};
+        FrameVector<size_t> first_triangle{FrameArena::get().allocator<size_t>()};
+        first_triangle.reserve(occluders.size());
+        for (const Drawable *occluder : occluders)
+        {
+            first_triangle.push_back(triangle_count);
+            triangle_count += occluder->get_mesh().indices.size() / 3;
+        }
+        // Clipping against the near plane turns a triangle into at most two.
+        triangles.resize(triangle_count * 2);
+
+        for (size_t i = 0; i < occluders.size(); i++)
+        {
+            const Mesh &mesh = occluders[i]->get_mesh();
+            glm::mat4 model_view_projection = view_projection * occluders[i]->get_model();
+            clip_vertices.resize(mesh.vertices.size());
+            ThreadPool::get().parallel_for(mesh.vertices.size(), 1024, [&](size_t begin, size_t end)
+            {
+                for (size_t v = begin; v < end; v++)
+                {
+                    clip_vertices[v] = model_view_projection * glm::vec4(mesh.vertices[v].position, 1.0f);
+                }
+            });
+            size_t first = first_triangle[i];
+            ThreadPool::get().parallel_for(mesh.indices.size() / 3, 256, [&](size_t begin, size_t end)
+            {
+                for (size_t t = begin; t < end; t++)
+                {
+                    setup_triangle(clip_vertices[mesh.indices[t * 3]], clip_vertices[mesh.indices[t * 3 + 1]], clip_vertices[mesh.indices[t * 3 + 2]],
+                                   triangles[(first + t) * 2], triangles[(first + t) * 2 + 1]);
+                }
+            });
+        }
+
+        ThreadPool::get().parallel_for(TILES_Y, 1, [this](size_t begin, size_t end)
+        {
+            rasterize_rows(static_cast<int32_t>(begin), static_cast<int32_t>(end));
+        });
+    };
+
+    // False only if the box is certainly hidden behind the occluders or outside the view.
+    bool is_visible(const Bounds &bounds, const glm::mat4 &model)
+    {
+        tested++;
+        glm::mat4 model_view_projection = view_projection * model;
+        // Empty starting bounds, so boxes entirely off an edge or beyond the far plane are rejected below.
+        glm::vec2 screen_min{std::numeric_limits<float>::max()};
+        glm::vec2 screen_max{std::numeric_limits<float>::lowest()};
+        float nearest{std::numeric_limits<float>::max()};
+        for (int i = 0; i < 8; i++)
+        {
+            glm::vec3 corner{(i & 1) ? bounds.max.x : bounds.min.x, (i & 2) ? bounds.max.y : bounds.min.y, (i & 4) ? bounds.max.z : bounds.min.z};
+            glm::vec4 clip = model_view_projection * glm::vec4(corner, 1.0f);
+            if (clip.z < -clip.w || clip.w <= 0.0f)
+            {
+                return true;
+            }
+            glm::vec3 screen = to_screen(clip);
+            screen_min = glm::min(screen_min, glm::vec2(screen.x, screen.y));
+            screen_max = glm::max(screen_max, glm::vec2(screen.x, screen.y));
+            nearest = std::min(nearest, screen.z);
+        }
+        if (screen_max.x < 0.0f || screen_max.y < 0.0f || screen_min.x >= WIDTH || screen_min.y >= HEIGHT || nearest > 1.0f)
+        {
+            culled++;
+            return false;
+        }
+
+        int32_t tile_min_x = std::clamp(static_cast<int32_t>(screen_min.x) / static_cast<int32_t>(TILE_WIDTH), 0, static_cast<int32_t>(TILES_X) - 1);
+        int32_t tile_max_x = std::clamp(static_cast<int32_t>(screen_max.x) / static_cast<int32_t>(TILE_WIDTH), 0, static_cast<int32_t>(TILES_X) - 1);
+        int32_t tile_min_y = std::clamp(static_cast<int32_t>(screen_min.y) / static_cast<int32_t>(TILE_HEIGHT), 0, static_cast<int32_t>(TILES_Y) - 1);
+        int32_t tile_max_y = std::clamp(static_cast<int32_t>(screen_max.y) / static_cast<int32_t>(TILE_HEIGHT), 0, static_cast<int32_t>(TILES_Y) - 1);
+        for (int32_t y = tile_min_y; y <= tile_max_y; y++)
+        {
+            for (int32_t x = tile_min_x; x <= tile_max_x; x++)
+            {
+                if (nearest < tiles[y * TILES_X + x].far_depth)
+                {
+                    return true;
+                }
+            }
+        }
+        culled++;
+        return false;
+    };
+
+    bool is_visible(const Drawable &drawable)
+    {
+        return is_visible(drawable.get_bounds(), drawable.get_model());
+    };
+
+    // Boxes tested and rejected since begin_frame.
+    uint32_t tested_count() const { return tested; };
+    uint32_t culled_count() const { return culled; };
+
+private:
+    struct Tile
+    {
+        uint32_t mask;
+        // Every pixel outside mask is at most this far.
+        float far_depth;
+        // Every pixel inside mask is at most this far.
+        float working_depth;
+    };
+
+    // Edge i is inside where edge_a[i] * x + edge_b[i] * y + edge_c[i] >= 0, depth is z_a * x + z_b * y + z_c.
+    struct ScreenTriangle
+    {
+        bool valid;
+        float edge_a[3];
+        float edge_b[3];
+        float edge_c[3];
+        float z_a;
+        float z_b;
+        float z_c;
+        float z_max;
+        int32_t tile_min_x;
+        int32_t tile_min_y;
+        int32_t tile_max_x;
+        int32_t tile_max_y;
+    };
+
+    glm::mat4 view_projection{1.0f};
+    std::vector<const Drawable *> occluders;
+    std::vector<glm::vec4> clip_vertices;
+    std::vector<ScreenTriangle> triangles;
+    std::vector<Tile> tiles = std::vector<Tile>(TILES_X * TILES_Y, Tile{0, 1.0f, 0.0f});
+    uint32_t tested{0};
+    uint32_t culled{0};
+
+    static glm::vec3 to_screen(const glm::vec4 &clip)
+    {
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        return glm::vec3((ndc.x * 0.5f + 0.5f) * WIDTH, (ndc.y * 0.5f + 0.5f) * HEIGHT, ndc.z * 0.5f + 0.5f);
+    };
+
+    // Clips against the near plane and writes up to two screen space triangles.
+    static void setup_triangle(const glm::vec4 &v0, const glm::vec4 &v1, const glm::vec4 &v2, ScreenTriangle &first, ScreenTriangle &second)
+    {
+        first.valid = false;
+        second.valid = false;
+        const glm::vec4 input[3]{v0, v1, v2};
+        // Trivially outside one of the side or far planes.
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if ((v0[axis] > v0.w && v1[axis] > v1.w && v2[axis] > v2.w) || (axis < 2 && v0[axis] < -v0.w && v1[axis] < -v1.w && v2[axis] < -v2.w))
+            {
+                return;
+            }
+        }
+
+        glm::vec4 polygon[4];
+        int count{0};
+        for (int i = 0; i < 3; i++)
+        {
+            const glm::vec4 &a = input[i];
+            const glm::vec4 &b = input[(i + 1) % 3];
+            float distance_a = a.z + a.w;
+            float distance_b = b.z + b.w;
+            if (distance_a >= 0.0f)
+            {
+                polygon[count++] = a;
+            }
+            if ((distance_a >= 0.0f) != (distance_b >= 0.0f))
+            {
+                polygon[count++] = a + (b - a) * (distance_a / (distance_a - distance_b));
+            }
+        }
+        if (count >= 3)
+        {
+            setup_screen_triangle(to_screen(polygon[0]), to_screen(polygon[1]), to_screen(polygon[2]), first);
+        }
+        if (count == 4)
+        {
+            setup_screen_triangle(to_screen(polygon[0]), to_screen(polygon[2]), to_screen(polygon[3]), second);
+        }
+    };
+
+    static void setup_screen_triangle(const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &p2, ScreenTriangle &triangle)
+    {
+        float area = (p1.x - p0.x) * (p2.y - p0.y) - (p2.x - p0.x) * (p1.y - p0.y);
+        // Back facing or degenerate, occluders are closed or single sided so these never hide anything new.
+        if (!(area > 0.0f))
+        {
+            return;
+        }
+        float min_x = std::min({p0.x, p1.x, p2.x});
+        float max_x = std::max({p0.x, p1.x, p2.x});
+        float min_y = std::min({p0.y, p1.y, p2.y});
+        float max_y = std::max({p0.y, p1.y, p2.y});
+        if (max_x < 0.0f || max_y < 0.0f || min_x >= WIDTH || min_y >= HEIGHT)
+        {
+            return;
+        }
+
+        const glm::vec3 points[3]{p0, p1, p2};
+        for (int i = 0; i < 3; i++)
+        {
+            const glm::vec3 &a = points[i];
+            const glm::vec3 &b = points[(i + 1) % 3];
+            triangle.edge_a[i] = a.y - b.y;
+            triangle.edge_b[i] = b.x - a.x;
+            triangle.edge_c[i] = a.x * b.y - b.x * a.y;
+        }
+        triangle.z_a = ((p1.z - p0.z) * (p2.y - p0.y) - (p2.z - p0.z) * (p1.y - p0.y)) / area;
+        triangle.z_b = ((p1.x - p0.x) * (p2.z - p0.z) - (p2.x - p0.x) * (p1.z - p0.z)) / area;
+        triangle.z_c = p0.z - triangle.z_a * p0.x - triangle.z_b * p0.y;
+        triangle.z_max = std::max({p0.z, p1.z, p2.z});
+        triangle.tile_min_x = std::max(static_cast<int32_t>(min_x) / static_cast<int32_t>(TILE_WIDTH), 0);
+        triangle.tile_max_x = std::min(static_cast<int32_t>(max_x) / static_cast<int32_t>(TILE_WIDTH), static_cast<int32_t>(TILES_X) - 1);
+        triangle.tile_min_y = std::max(static_cast<int32_t>(min_y) / static_cast<int32_t>(TILE_HEIGHT), 0);
+        triangle.tile_max_y = std::min(static_cast<int32_t>(max_y) / static_cast<int32_t>(TILE_HEIGHT), static_cast<int32_t>(TILES_Y) - 1);
+        triangle.valid = true;
+    };
+
+    // Triangles are walked in submission order for every tile, so the result does not depend on threading.
+    void rasterize_rows(int32_t first_row, int32_t end_row)
+    {
+        for (const auto &triangle : triangles)
+        {
+            if (!triangle.valid || triangle.tile_max_y < first_row || triangle.tile_min_y >= end_row)
+            {
+                continue;
+            }
+            int32_t last_row = std::min(triangle.tile_max_y, end_row - 1);
+            for (int32_t y = std::max(triangle.tile_min_y, first_row); y <= last_row; y++)
+            {
+                for (int32_t x = triangle.tile_min_x; x <= triangle.tile_max_x; x++)
+                {
+                    rasterize_tile(triangle, x, y);
+                }
+            }
+        }
+    };
+
+    void rasterize_tile(const ScreenTriangle &triangle, int32_t tile_x, int32_t tile_y)
+    {
+        Tile &tile = tiles[tile_y * TILES_X + tile_x];
+        float x0 = static_cast<float>(tile_x * TILE_WIDTH) + 0.5f;
+        float y0 = static_cast<float>(tile_y * TILE_HEIGHT) + 0.5f;
+        float x1 = x0 + TILE_WIDTH - 1;
+        float y1 = y0 + TILE_HEIGHT - 1;
+
+        // The depth plane is linear, so its maximum over the covered pixel centers is at a corner of the tile.
+        float depth = std::max({triangle.z_a * x0 + triangle.z_b * y0, triangle.z_a * x1 + triangle.z_b * y0,
+                                triangle.z_a * x0 + triangle.z_b * y1, triangle.z_a * x1 + triangle.z_b * y1}) + triangle.z_c;
+        depth = std::min(depth, triangle.z_max);
+        if (depth >= tile.far_depth)
+        {
+            return;
+        }
+
+        uint32_t coverage = coverage_mask(triangle, x0, y0);
+        if (coverage == 0)
+        {
+            return;
+        }
+
+        // Start a new working layer when the triangle is nearer the far depth than the current working layer,
+        // merging would push the working depth back almost to the far depth anyway.
+        if (tile.mask != 0 && depth - tile.working_depth > tile.far_depth - depth)
+        {
+            tile.mask = 0;
+        }
+        tile.working_depth = tile.mask == 0 ? depth : std::max(tile.working_depth, depth);
+        tile.mask |= coverage;
+        if (tile.mask == FULL_MASK)
+        {
+            tile.far_depth = tile.working_depth;
+            tile.mask = 0;
+        }
+    };
+
+    // Bit row * TILE_WIDTH + column is set for every pixel center inside all three edges.
+    static uint32_t coverage_mask(const ScreenTriangle &triangle, float x0, float y0)
+    {
+        uint32_t mask{0};
+#if OCCLUSION_CULLER_AVX2
+        __m256 xs = _mm256_add_ps(_mm256_set1_ps(x0), _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f));
+        __m256 edge_x[3];
+        for (int i = 0; i < 3; i++)
+        {
+            edge_x[i] = _mm256_mul_ps(_mm256_set1_ps(triangle.edge_a[i]), xs);
+        }
+        for (uint32_t row = 0; row < TILE_HEIGHT; row++)
+        {
+            float y = y0 + row;
+            __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (int i = 0; i < 3; i++)
+            {
+                __m256 value = _mm256_add_ps(edge_x[i], _mm256_set1_ps(triangle.edge_b[i] * y + triangle.edge_c[i]));
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(value, _mm256_setzero_ps(), _CMP_GE_OQ));
+            }
+            mask |= static_cast<uint32_t>(_mm256_movemask_ps(inside)) << (row * TILE_WIDTH);
+        }
+#elif OCCLUSION_CULLER_SSE
+        __m128 xs_low = _mm_add_ps(_mm_set1_ps(x0), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+        __m128 xs_high = _mm_add_ps(xs_low, _mm_set1_ps(4.0f));
+        for (uint32_t row = 0; row < TILE_HEIGHT; row++)
+        {
+            float y = y0 + row;
+            __m128 inside_low = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            __m128 inside_high = inside_low;
+            for (int i = 0; i < 3; i++)
+            {
+                __m128 a = _mm_set1_ps(triangle.edge_a[i]);
+                __m128 offset = _mm_set1_ps(triangle.edge_b[i] * y + triangle.edge_c[i]);
+                inside_low = _mm_and_ps(inside_low, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a, xs_low), offset), _mm_setzero_ps()));
+                inside_high = _mm_and_ps(inside_high, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a, xs_high), offset), _mm_setzero_ps()));
+            }
+            uint32_t bits = static_cast<uint32_t>(_mm_movemask_ps(inside_low)) | (static_cast<uint32_t>(_mm_movemask_ps(inside_high)) << 4);
+            mask |= bits << (row * TILE_WIDTH);
+        }
+#else
+        for (uint32_t row = 0; row < TILE_HEIGHT; row++)
+        {
+            float y = y0 + row;
+            for (uint32_t column = 0; column < TILE_WIDTH; column++)
+            {
+                float x = x0 + column;
+                bool inside{true};
+                for (int i = 0; i < 3; i++)
+                {
+                    inside = inside && triangle.edge_a[i] * x + (triangle.edge_b[i] * y + triangle.edge_c[i]) >= 0.0f;
+                }
+                mask |= static_cast<uint32_t>(inside) << (row * TILE_WIDTH + column);
+            }
+        }
+#endif
+        return mask;
+    };
+};
+
+#endif
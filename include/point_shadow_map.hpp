@@ -0,0 +1,285 @@
+#ifndef POINT_SHADOW_MAP_HPP
+#define POINT_SHADOW_MAP_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "model.hpp"
+#include "profiler.hpp"
+#include "shader.hpp"
+
+// Omnidirectional shadows for one point light. All six cube faces are rendered in one pass by shadow.geom
+// through a layered framebuffer. Static casters live in their own cube that is only redrawn when the light
+// moves, every frame the faces touched by moving dynamic casters get the static depth copied in and the
+// dynamic casters drawn on top. Untouched faces keep last frame's result. Any move of the light invalidates
+// the static cube, so the cache only pays off while the light stands still. A light that moves every frame
+// redraws all static casters into all faces every frame.
+class PointShadowMap
+{
+public:
+    static constexpr uint32_t FACE_COUNT{6};
+    static constexpr uint32_t ALL_FACES{(1u << FACE_COUNT) - 1};
+    // Unit the cube is sampled from, clear of the G-buffer (0-2) and the clustered buffers (4-6).
+    static constexpr int32_t TEXTURE_UNIT{3};
+
+    PointShadowMap() = default;
+    PointShadowMap(const PointShadowMap &) = delete;
+    PointShadowMap &operator=(const PointShadowMap &) = delete;
+
+    ~PointShadowMap()
+    {
+        glDeleteFramebuffers(1, &layered_framebuffer);
+        glDeleteFramebuffers(2, face_framebuffers);
+        glDeleteTextures(1, &static_cube);
+        glDeleteTextures(1, &shadow_cube);
+    };
+
+    void init(uint32_t _resolution, float _near_plane, float _far_plane)
+    {
+        resolution = _resolution;
+        near_plane = _near_plane;
+        far_plane = _far_plane;
+        static_cube = create_cube();
+        shadow_cube = create_cube();
+        glGenFramebuffers(1, &layered_framebuffer);
+        glGenFramebuffers(2, face_framebuffers);
+        // Depth only framebuffers, GL 3.3 reports them incomplete unless the color buffers are disabled.
+        for (uint32_t framebuffer : {layered_framebuffer, face_framebuffers[0], face_framebuffers[1]})
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            glDrawBuffer(GL_NONE);
+            glReadBuffer(GL_NONE);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    };
+
+    // Static casters are expected to stay put, if one moves anyway the static cube is rebuilt.
+    void add_caster(const Drawable *drawable, bool is_static)
+    {
+        // Bounds rather than vertices, drawables uploaded from a mesh file keep no vertices around.
+        const Bounds &bounds = drawable->get_bounds();
+        float radius = glm::length(glm::max(glm::abs(bounds.min), glm::abs(bounds.max)));
+        casters.push_back(Caster{drawable, is_static, radius, drawable->get_model(), 0, true});
+        if (is_static)
+        {
+            static_dirty = true;
+        }
+    };
+
+    void set_light_position(const glm::vec3 &position)
+    {
+        if (position != light_position)
+        {
+            light_position = position;
+            static_dirty = true;
+        }
+    };
+
+    // Brings the shadow cube up to date, redrawing only what changed since the last call.
+    void update(Shader &shader)
+    {
+        PROFILE_FUNCTION();
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glViewport(0, 0, resolution, resolution);
+
+        uint32_t dirty_faces{0};
+        for (auto &caster : casters)
+        {
+            const glm::mat4 &model = caster.drawable->get_model();
+            uint32_t faces = face_mask(caster, model);
+            bool moved = caster.moved || model != caster.last_model;
+            if (moved && caster.is_static)
+            {
+                static_dirty = true;
+            }
+            if (moved && !caster.is_static)
+            {
+                // Faces it left must lose its old depth, faces it entered must get the new one.
+                dirty_faces |= faces | caster.faces;
+            }
+            caster.faces = faces;
+            caster.last_model = model;
+            caster.moved = false;
+        }
+
+        static const char *const matrix_names[FACE_COUNT]{
+            "shadow_matrices[0]", "shadow_matrices[1]", "shadow_matrices[2]", "shadow_matrices[3]", "shadow_matrices[4]", "shadow_matrices[5]",
+        };
+        shader.use();
+        for (uint32_t face = 0; face < FACE_COUNT; face++)
+        {
+            shader.set_mat4(matrix_names[face], face_matrix(face));
+        }
+        shader.set_vec3("light_position", light_position);
+        shader.set_float("shadow_far_plane", far_plane);
+
+        if (static_dirty)
+        {
+            render_casters(shader, static_cube, true, ALL_FACES);
+            static_dirty = false;
+            dirty_faces = ALL_FACES;
+        }
+        if (dirty_faces != 0)
+        {
+            copy_static_faces(dirty_faces);
+            render_casters(shader, shadow_cube, false, dirty_faces);
+        }
+        faces_rendered = dirty_faces;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    };
+
+    // Sets the uniforms lighting.glsl reads when built with SHADOWS=1.
+    void bind(Shader &shader, bool enabled) const
+    {
+        glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, shadow_cube);
+        glActiveTexture(GL_TEXTURE0);
+        shader.set_int("shadow_map", TEXTURE_UNIT);
+        shader.set_float("shadow_far_plane", far_plane);
+        shader.set_bool("shadows_enabled", enabled);
+    };
+
+    // Bit per cube face redrawn by the last update, zero when the cached cube was reused as is.
+    uint32_t last_rendered_faces() const { return faces_rendered; };
+
+private:
+    struct Caster
+    {
+        const Drawable *drawable;
+        bool is_static;
+        float radius;
+        glm::mat4 last_model;
+        uint32_t faces;
+        bool moved;
+    };
+
+    uint32_t resolution{512};
+    float near_plane{0.01f};
+    float far_plane{10.0f};
+    glm::vec3 light_position{0.0f};
+    bool static_dirty{true};
+    uint32_t faces_rendered{0};
+
+    uint32_t static_cube{0};
+    uint32_t shadow_cube{0};
+    uint32_t layered_framebuffer{0};
+    uint32_t face_framebuffers[2]{};
+    std::vector<Caster> casters;
+
+    uint32_t create_cube() const
+    {
+        uint32_t texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+        for (uint32_t face = 0; face < FACE_COUNT; face++)
+        {
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_DEPTH_COMPONENT24, resolution, resolution, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+        }
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        return texture;
+    };
+
+    glm::mat4 face_matrix(uint32_t face) const
+    {
+        static const std::array<glm::vec3, FACE_COUNT> directions{
+            glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
+            glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+            glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+        };
+        static const std::array<glm::vec3, FACE_COUNT> ups{
+            glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+            glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+            glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+        };
+        glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, near_plane, far_plane);
+        return projection * glm::lookAt(light_position, light_position + directions[face], ups[face]);
+    };
+
+    // Faces whose 90 degree frustum the caster's bounding sphere touches. Face 2k looks down +axis k,
+    // face 2k+1 down -axis k.
+    uint32_t face_mask(const Caster &caster, const glm::mat4 &model) const
+    {
+        glm::vec3 center = glm::vec3(model[3]) - light_position;
+        float scale = std::max({glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))});
+        float radius = caster.radius * scale;
+        if (glm::length(center) <= radius)
+        {
+            return ALL_FACES;
+        }
+        // Side planes of a face frustum are 45 degrees off its axis, sqrt(2) turns the plane distance into the
+        // difference of coordinates.
+        float slack = radius * std::sqrt(2.0f);
+        uint32_t mask{0};
+        for (uint32_t axis = 0; axis < 3; axis++)
+        {
+            float u = center[(axis + 1) % 3];
+            float v = center[(axis + 2) % 3];
+            for (uint32_t side = 0; side < 2; side++)
+            {
+                float forward = side == 0 ? center[axis] : -center[axis];
+                if (forward + slack >= std::abs(u) && forward + slack >= std::abs(v))
+                {
+                    mask |= 1u << (axis * 2 + side);
+                }
+            }
+        }
+        return mask;
+    };
+
+    void render_casters(Shader &shader, uint32_t cube, bool is_static, uint32_t faces)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, layered_framebuffer);
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, cube, 0);
+        if (is_static)
+        {
+            glClear(GL_DEPTH_BUFFER_BIT);
+        }
+
+        for (const auto &caster : casters)
+        {
+            uint32_t caster_faces = caster.faces & faces;
+            if (caster.is_static != is_static || caster_faces == 0)
+            {
+                continue;
+            }
+            shader.use();
+            shader.set_int("face_mask", static_cast<int32_t>(caster_faces));
+            // Drawable::draw is not const but only reads the object.
+            const_cast<Drawable *>(caster.drawable)->draw(shader);
+        }
+    };
+
+    // Resets the given faces of the shadow cube to the static depth before dynamic casters are added.
+    void copy_static_faces(uint32_t faces)
+    {
+        for (uint32_t face = 0; face < FACE_COUNT; face++)
+        {
+            if ((faces & (1u << face)) == 0)
+            {
+                continue;
+            }
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, face_framebuffers[0]);
+            glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, static_cube, 0);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, face_framebuffers[1]);
+            glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, shadow_cube, 0);
+            glBlitFramebuffer(0, 0, resolution, resolution, 0, 0, resolution, resolution, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        }
+    };
+};
+
+#endif
@@ -0,0 +1,229 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "logger.hpp"
+
+// Profiling zones are compiled in for debug builds, release builds need ENABLE_PROFILING.
+#if !defined(NDEBUG) || defined(ENABLE_PROFILING)
+#define PROFILING_ENABLED 1
+#else
+#define PROFILING_ENABLED 0
+#endif
+
+struct ProfileEvent
+{
+    const char *name;
+    int64_t start;
+    int64_t end;
+};
+
+// Written only by its owning thread, read by the exporter up to the published count.
+// The ring keeps the newest CAPACITY events per thread.
+class ProfileThreadBuffer
+{
+public:
+    static constexpr size_t CAPACITY{1 << 16};
+
+    uint32_t thread_id;
+    std::unique_ptr<ProfileEvent[]> events{new ProfileEvent[CAPACITY]};
+    std::atomic<uint64_t> count{0};
+
+    explicit ProfileThreadBuffer(uint32_t _thread_id) : thread_id{_thread_id} {};
+
+    void push(const ProfileEvent &event)
+    {
+        uint64_t index = count.load(std::memory_order_relaxed);
+        events[index & (CAPACITY - 1)] = event;
+        count.store(index + 1, std::memory_order_release);
+    };
+};
+
+class Profiler
+{
+public:
+    static constexpr size_t FRAME_HISTORY{1024};
+
+    static Profiler &get()
+    {
+        static Profiler profiler;
+        return profiler;
+    };
+
+    Profiler(const Profiler &) = delete;
+    Profiler &operator=(const Profiler &) = delete;
+
+    static int64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    };
+
+    void record(const char *name, int64_t start, int64_t end)
+    {
+        thread_buffer().push(ProfileEvent{name, start, end});
+    };
+
+    // Marks the start of a new frame, also finishes a pending capture once its last frame has ended.
+    void begin_frame()
+    {
+        int64_t timestamp = now();
+        uint64_t frame = frame_index.load(std::memory_order_relaxed) + 1;
+        frame_starts[frame % FRAME_HISTORY] = timestamp;
+        frame_index.store(frame, std::memory_order_release);
+
+        if (!capture_path.empty() && frame > capture_last_frame)
+        {
+            if (!export_chrome_trace(capture_path, capture_first_frame, capture_last_frame))
+            {
+                Logger::get().error("Failed to write trace to {}", capture_path);
+            }
+            else
+            {
+                Logger::get().info("Trace of frames {}-{} written to {}", capture_first_frame, capture_last_frame, capture_path);
+            }
+            capture_path.clear();
+        }
+    };
+
+    uint64_t current_frame() const { return frame_index.load(std::memory_order_acquire); };
+
+    // Captures the next frame_count frames and writes them to path when the last one ends.
+    void request_capture(const std::string &path, uint32_t frame_count)
+    {
+        if (!capture_path.empty() || frame_count == 0)
+        {
+            return;
+        }
+        capture_path = path;
+        capture_first_frame = current_frame() + 1;
+        capture_last_frame = capture_first_frame + std::min<uint64_t>(frame_count, FRAME_HISTORY - 2) - 1;
+    };
+
+    // Writes Chrome trace event JSON (chrome://tracing, Perfetto) for frames that are still in the history.
+    bool export_chrome_trace(const std::string &path, uint64_t first_frame, uint64_t last_frame)
+    {
+        uint64_t frame = current_frame();
+        if (first_frame == 0 || last_frame >= frame || first_frame > last_frame || frame - first_frame >= FRAME_HISTORY)
+        {
+            return false;
+        }
+        int64_t range_start = frame_starts[first_frame % FRAME_HISTORY];
+        int64_t range_end = frame_starts[(last_frame + 1) % FRAME_HISTORY];
+
+        std::FILE *file = std::fopen(path.c_str(), "w");
+        if (file == nullptr)
+        {
+            return false;
+        }
+
+        std::fputs("{\"traceEvents\":[\n", file);
+        bool first_event{true};
+        auto write_event = [&](const char *name, uint32_t thread_id, int64_t start, int64_t end)
+        {
+            std::fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", first_event ? "" : ",\n", name, thread_id, (start - range_start) / 1000.0, (end - start) / 1000.0);
+            first_event = false;
+        };
+
+        for (uint64_t i = first_frame; i <= last_frame; i++)
+        {
+            write_event("Frame", 0, frame_starts[i % FRAME_HISTORY], frame_starts[(i + 1) % FRAME_HISTORY]);
+        }
+
+        std::lock_guard<std::mutex> lock{buffers_mutex};
+        std::vector<ProfileEvent> events;
+        for (const auto &buffer : buffers)
+        {
+            // Owning threads keep pushing while we read. Only events published before the snapshot are
+            // copied, and the oldest ones are dropped again if the writer has wrapped around onto them since.
+            uint64_t count = buffer->count.load(std::memory_order_acquire);
+            uint64_t oldest = count > ProfileThreadBuffer::CAPACITY ? count - ProfileThreadBuffer::CAPACITY : 0;
+            events.clear();
+            for (uint64_t i = oldest; i < count; i++)
+            {
+                events.push_back(buffer->events[i & (ProfileThreadBuffer::CAPACITY - 1)]);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            uint64_t written = buffer->count.load(std::memory_order_relaxed);
+            // The slot of written - CAPACITY may be half overwritten by the push in progress.
+            uint64_t first_intact = written >= ProfileThreadBuffer::CAPACITY ? written - ProfileThreadBuffer::CAPACITY + 1 : 0;
+            for (uint64_t i = std::max(oldest, first_intact); i < count; i++)
+            {
+                const ProfileEvent &event = events[i - oldest];
+                if (event.start >= range_start && event.end <= range_end)
+                {
+                    write_event(event.name, buffer->thread_id, event.start, event.end);
+                }
+            }
+        }
+        std::fputs("\n],\"displayTimeUnit\":\"ms\"}\n", file);
+
+        return std::fclose(file) == 0;
+    };
+
+private:
+    std::mutex buffers_mutex;
+    std::vector<std::unique_ptr<ProfileThreadBuffer>> buffers;
+
+    std::atomic<uint64_t> frame_index{0};
+    std::vector<int64_t> frame_starts = std::vector<int64_t>(FRAME_HISTORY, 0);
+
+    std::string capture_path;
+    uint64_t capture_first_frame{};
+    uint64_t capture_last_frame{};
+
+    Profiler() = default;
+
+    // Buffers are owned by the profiler so events of finished threads remain exportable.
+    ProfileThreadBuffer &thread_buffer()
+    {
+        thread_local ProfileThreadBuffer *buffer{nullptr};
+        if (buffer == nullptr)
+        {
+            std::lock_guard<std::mutex> lock{buffers_mutex};
+            buffers.push_back(std::make_unique<ProfileThreadBuffer>(static_cast<uint32_t>(buffers.size())));
+            buffer = buffers.back().get();
+        }
+        return *buffer;
+    };
+};
+
+class ProfileScope
+{
+private:
+    const char *name;
+    int64_t start;
+
+public:
+    explicit ProfileScope(const char *_name) : name{_name}, start{Profiler::now()} {};
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+    ~ProfileScope()
+    {
+        Profiler::get().record(name, start, Profiler::now());
+    };
+};
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+
+#if PROFILING_ENABLED
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__){name}
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__func__)
+#define PROFILE_BEGIN_FRAME() Profiler::get().begin_frame()
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_FUNCTION() ((void)0)
+#define PROFILE_BEGIN_FRAME() ((void)0)
+#endif
+
+#endif
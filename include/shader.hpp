@@ -1,26 +1,70 @@
 #ifndef SHADER_HPP
 #define SHADER_HPP
 
+#include <algorithm>
 #include <string>
-#include <fstream>
-#include <sstream>
-#include <iostream>
 #include <utility>
+#include <vector>
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include "glad_extensions.hpp"
+#include "logger.hpp"
+#include "profiler.hpp"
+#include "shader_cache.hpp"
+#include "shader_preprocessor.hpp"
+#include "shader_sources.hpp"
+
+// One source file per pipeline stage. Names are file names in src/shaders, see shader_sources.hpp.
+struct ShaderStage
+{
+    GLenum type;
+    std::string name;
+};
+
+using ShaderStages = std::vector<ShaderStage>;
+
 class Shader
 {
 private:
-    std::string vertex_path{};
-    std::string fragment_path{};
+    enum class State
+    {
+        empty,
+        compiling,
+        ready,
+        failed
+    };
+
+    struct Stage
+    {
+        GLenum type{};
+        std::string name{};
+        std::vector<std::string> files{};
+        std::string source{};
+        uint32_t handle{};
+    };
+
+    std::vector<Stage> stages{};
+    ShaderDefines defines{};
     unsigned int ID{};
 
+    State state{State::empty};
+    const ShaderCache *pending_cache{};
+    uint64_t cache_key{};
+
 public:
 
     Shader() = default;
-    Shader(const std::string &_vertex_path, const std::string &_fragment_path) : vertex_path{_vertex_path}, fragment_path{_fragment_path}{};
+    // Defines select a permutation.
+    Shader(const std::string &_vertex_name, const std::string &_fragment_name, const ShaderDefines &_defines = {}) : Shader{ShaderStages{{GL_VERTEX_SHADER, _vertex_name}, {GL_FRAGMENT_SHADER, _fragment_name}}, _defines} {};
+    Shader(const ShaderStages &_stages, const ShaderDefines &_defines = {}) : defines{_defines}
+    {
+        for (const auto &stage : _stages)
+        {
+            stages.push_back(Stage{stage.type, stage.name});
+        }
+    };
     
     Shader& operator=(Shader&& shader)
     {
@@ -29,103 +73,229 @@ public:
             return *this;
         }
 
-        std::swap(vertex_path, shader.vertex_path);
-        std::swap(fragment_path, shader.fragment_path);
+        std::swap(stages, shader.stages);
+        std::swap(defines, shader.defines);
         std::swap(ID, shader.ID);
+        std::swap(state, shader.state);
+        std::swap(pending_cache, shader.pending_cache);
+        std::swap(cache_key, shader.cache_key);
 
         return *this;
     };
 
-    void init()
+    // Blocking compile, equivalent to submit() followed by finish().
+    void init(const ShaderCache *cache = nullptr)
     {
-        std::string vertex_shader_code{};
-        std::string fragment_shader_code{};
-        std::ifstream vert_shader_file{};
-        std::ifstream frag_shader_file{};
-        vert_shader_file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        frag_shader_file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        try
-        {
-            vert_shader_file.open(vertex_path);
-            frag_shader_file.open(fragment_path);
-            std::stringstream vert_shader_stream{};
-            std::stringstream frag_shader_stream{};
-            vert_shader_stream << vert_shader_file.rdbuf();
-            frag_shader_stream << frag_shader_file.rdbuf();
-            vert_shader_file.close();
-            frag_shader_file.close();
+        PROFILE_FUNCTION();
+        submit(cache);
+        finish();
+    };
 
-            vertex_shader_code = vert_shader_stream.str();
-            fragment_shader_code = frag_shader_stream.str();
-        }
-        catch (std::ifstream::failure e)
+    // Starts compiling and linking without querying any status, so the driver can work on several programs
+    // at once. With a cache the program is loaded from a stored binary if possible.
+    void submit(const ShaderCache *cache = nullptr, const ShaderSourceLoader &loader = read_shader_source)
+    {
+        PROFILE_FUNCTION();
+        std::vector<std::string> sources;
+        for (auto &stage : stages)
         {
-            std::cout << "File not succefully read\n";
+            PreprocessedShader shader{ShaderPreprocessor::process(stage.name, defines, loader)};
+            stage.files = std::move(shader.files);
+            sources.push_back(std::move(shader.source));
         }
 
-        const char *vertex_shader_source = vertex_shader_code.c_str();
-        const char *fragment_shader_source = fragment_shader_code.c_str();
-
-        uint32_t vertex{glCreateShader(GL_VERTEX_SHADER)};
-        uint32_t fragment{glCreateShader(GL_FRAGMENT_SHADER)};
+        submit_sources(std::move(sources), cache);
+    };
 
-        glShaderSource(vertex, 1, &vertex_shader_source, nullptr);
-        glCompileShader(vertex);
+    // Same as submit() with final sources, one per stage, that need no preprocessing.
+    void submit_sources(std::vector<std::string> sources, const ShaderCache *cache = nullptr)
+    {
+        for (size_t i = 0; i < stages.size() && i < sources.size(); i++)
+        {
+            stages[i].source = std::move(sources[i]);
+        }
 
-        glShaderSource(fragment, 1, &fragment_shader_source, nullptr);
-        glCompileShader(fragment);
+        pending_cache = cache != nullptr && cache->is_enabled() ? cache : nullptr;
+        if (pending_cache != nullptr)
+        {
+            std::vector<std::string> stage_sources;
+            for (const auto &stage : stages)
+            {
+                stage_sources.push_back(stage.source);
+            }
+            cache_key = pending_cache->key(stage_sources);
+            ID = glCreateProgram();
+            if (pending_cache->load(cache_key, ID))
+            {
+                pending_cache = nullptr;
+                state = State::ready;
+                return;
+            }
+            glDeleteProgram(ID);
+        }
 
-        int32_t error_status;
-        glGetShaderiv(vertex, GL_COMPILE_STATUS, &error_status);
+        ID = glCreateProgram();
+        for (auto &stage : stages)
+        {
+            const char *stage_source = stage.source.c_str();
+            stage.handle = glCreateShader(stage.type);
+            glShaderSource(stage.handle, 1, &stage_source, nullptr);
+            glCompileShader(stage.handle);
+            glAttachShader(ID, stage.handle);
+        }
+        if (pending_cache != nullptr)
+        {
+            glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+        glLinkProgram(ID);
+        state = State::compiling;
+    };
 
-        char error_log[512];
-        if (!error_status)
+    // Never blocks when KHR_parallel_shader_compile is available, otherwise waits for the driver.
+    // Throws if compilation or linking failed.
+    bool is_ready()
+    {
+        if (state == State::compiling && GLAD_EXTENSIONS.parallel_shader_compile)
         {
-            glGetShaderInfoLog(vertex, 512, nullptr, error_log);
-            std::cout << error_log << "\n";
-            throw std::runtime_error("Vertex shader compilation failed.");
+            int32_t completed{0};
+            glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &completed);
+            if (!completed)
+            {
+                return false;
+            }
         }
+        finish();
+        return state == State::ready;
+    };
 
-        glGetShaderiv(fragment, GL_COMPILE_STATUS, &error_status);
-        if (!error_status)
+    // Waits for a submitted program and checks the result.
+    void finish()
+    {
+        if (state != State::compiling)
         {
-            glGetShaderInfoLog(fragment, 512, nullptr, error_log);
-            std::cout << error_log << "\n";
-            throw std::runtime_error("Fragment shader compilation failed.");
+            return;
         }
+        state = State::failed;
 
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        glLinkProgram(ID);
+        int32_t error_status;
+        char error_log[512];
+        for (const auto &stage : stages)
+        {
+            glGetShaderiv(stage.handle, GL_COMPILE_STATUS, &error_status);
+            if (!error_status)
+            {
+                glGetShaderInfoLog(stage.handle, 512, nullptr, error_log);
+                Logger::get().error("{}{}", error_log, source_numbers(stage.files));
+                throw std::runtime_error(stage_label(stage.type) + " shader compilation failed.");
+            }
+        }
 
         glGetProgramiv(ID, GL_LINK_STATUS, &error_status);
         if (!error_status)
         {
             glGetProgramInfoLog(ID, 512, nullptr, error_log);
-            std::cout << error_log << "\n";
+            Logger::get().error("{}", error_log);
             throw std::runtime_error("Shader link failed.");
         }
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
+        for (auto &stage : stages)
+        {
+            glDeleteShader(stage.handle);
+            stage.handle = 0;
+        }
+        state = State::ready;
+
+        if (pending_cache != nullptr)
+        {
+            pending_cache->store(cache_key, ID);
+            pending_cache = nullptr;
+        }
+    };
+
+    ShaderStages get_stages() const
+    {
+        ShaderStages result;
+        for (const auto &stage : stages)
+        {
+            result.push_back(ShaderStage{stage.type, stage.name});
+        }
+        return result;
+    };
+    const ShaderDefines &get_defines() const { return defines; };
+
+    // Stage file names separated by spaces, for log messages.
+    std::string get_name() const
+    {
+        std::string result;
+        for (const auto &stage : stages)
+        {
+            result += (result.empty() ? "" : " ") + stage.name;
+        }
+        return result;
+    };
+
+    // True if the file is one of the sources or includes of the last submitted program.
+    bool depends_on(const std::string &name) const
+    {
+        return std::any_of(stages.begin(), stages.end(), [&name](const Stage &stage)
+        {
+            return std::find(stage.files.begin(), stage.files.end(), name) != stage.files.end();
+        });
     };
 
     void use() { glUseProgram(ID); };
-    void set_bool(const std::string &name, bool value) const { glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); };
-    void set_int(const std::string &name, int value) const { glUniform1i(glGetUniformLocation(ID, name.c_str()), value); };
-    void set_float(const std::string &name, float value) const { glUniform1f(glGetUniformLocation(ID, name.c_str()), value); };
-    void set_vec2(const std::string &name, const glm::vec2 &value) const { glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); };
-    void set_vec2(const std::string &name, float x, float y) const { glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); };
-    void set_vec3(const std::string &name, const glm::vec3 &value) const { glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); };
-    void set_vec3(const std::string &name, float x, float y, float z) const { glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); };
-    void set_vec4(const std::string &name, const glm::vec4 &value) const { glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); };
-    void set_vec4(const std::string &name, float x, float y, float z, float w) const { glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); };
-    void set_mat2(const std::string &name, const glm::mat2 &value) const { glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &value[0][0]); };
-    void set_mat3(const std::string &name, const glm::mat3 &value) const { glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &value[0][0]); };
-    void set_mat4(const std::string &name, const glm::mat4 &value) const { glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &value[0][0]); };
+    void set_bool(const char *name, bool value) const { glUniform1i(glGetUniformLocation(ID, name), (int)value); };
+    void set_int(const char *name, int value) const { glUniform1i(glGetUniformLocation(ID, name), value); };
+    void set_float(const char *name, float value) const { glUniform1f(glGetUniformLocation(ID, name), value); };
+    void set_vec2(const char *name, const glm::vec2 &value) const { glUniform2fv(glGetUniformLocation(ID, name), 1, &value[0]); };
+    void set_vec2(const char *name, float x, float y) const { glUniform2f(glGetUniformLocation(ID, name), x, y); };
+    void set_vec3(const char *name, const glm::vec3 &value) const { glUniform3fv(glGetUniformLocation(ID, name), 1, &value[0]); };
+    void set_vec3(const char *name, float x, float y, float z) const { glUniform3f(glGetUniformLocation(ID, name), x, y, z); };
+    void set_vec4(const char *name, const glm::vec4 &value) const { glUniform4fv(glGetUniformLocation(ID, name), 1, &value[0]); };
+    void set_vec4(const char *name, float x, float y, float z, float w) const { glUniform4f(glGetUniformLocation(ID, name), x, y, z, w); };
+    void set_mat2(const char *name, const glm::mat2 &value) const { glUniformMatrix2fv(glGetUniformLocation(ID, name), 1, GL_FALSE, &value[0][0]); };
+    void set_mat3(const char *name, const glm::mat3 &value) const { glUniformMatrix3fv(glGetUniformLocation(ID, name), 1, GL_FALSE, &value[0][0]); };
+    void set_mat4(const char *name, const glm::mat4 &value) const { glUniformMatrix4fv(glGetUniformLocation(ID, name), 1, GL_FALSE, &value[0][0]); };
+
+private:
+    // Maps the source string numbers in compiler messages back to file names.
+    static std::string source_numbers(const std::vector<std::string> &files)
+    {
+        std::string result{files.size() > 1 ? "Source numbers:" : ""};
+        for (size_t i = 0; i < files.size() && files.size() > 1; i++)
+        {
+            result += " " + std::to_string(i) + "=" + files[i];
+        }
+        return result;
+    };
+
+    static std::string stage_label(GLenum type)
+    {
+        switch (type)
+        {
+        case GL_VERTEX_SHADER:
+            return "Vertex";
+        case GL_TESS_CONTROL_SHADER:
+            return "Tessellation control";
+        case GL_TESS_EVALUATION_SHADER:
+            return "Tessellation evaluation";
+        case GL_GEOMETRY_SHADER:
+            return "Geometry";
+        case GL_FRAGMENT_SHADER:
+            return "Fragment";
+        case GL_COMPUTE_SHADER:
+            return "Compute";
+        default:
+            return "Stage " + std::to_string(type);
+        }
+    };
 
+public:
     ~Shader()
     {
+        for (const auto &stage : stages)
+        {
+            glDeleteShader(stage.handle);
+        }
         glDeleteProgram(ID);
     };
 };
@@ -0,0 +1,166 @@
+#ifndef SHADER_CACHE_HPP
+#define SHADER_CACHE_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "atomic_file.hpp"
+#include "glad_extensions.hpp"
+#include "logger.hpp"
+
+// Stores linked program binaries on disk, keyed by a hash of the sources and the driver identity.
+// A binary the driver rejects (e.g. after a driver update) is deleted and the caller compiles from source.
+class ShaderCache
+{
+private:
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t format;
+        uint32_t length;
+        uint32_t reserved;
+    };
+
+    static constexpr uint32_t MAGIC{0x50524742}; // "BGRP"
+
+    std::filesystem::path directory;
+    std::string driver;
+    bool enabled{false};
+
+public:
+    ShaderCache() = default;
+    explicit ShaderCache(const std::string &_directory) : directory{_directory} {};
+
+    // Must be called with a current context, disables the cache if the driver has no binary formats.
+    void init()
+    {
+        int32_t formats{0};
+        if (GLAD_EXTENSIONS.program_binary)
+        {
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        }
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        enabled = formats > 0 && !error;
+        if (!enabled)
+        {
+            Logger::get().info("Program binary cache disabled");
+            return;
+        }
+        for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+        {
+            const char *value = reinterpret_cast<const char *>(glGetString(name));
+            driver += value != nullptr ? value : "";
+            driver += '\n';
+        }
+    };
+
+    bool is_enabled() const { return enabled; };
+
+    // FNV-1a over the stage sources and the driver strings.
+    uint64_t key(const std::vector<std::string> &sources) const
+    {
+        uint64_t hash{14695981039346656037ull};
+        auto append = [&hash](const std::string &part)
+        {
+            for (char c : part)
+            {
+                hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+            }
+            hash = (hash ^ 0xFF) * 1099511628211ull;
+        };
+        for (const auto &source : sources)
+        {
+            append(source);
+        }
+        append(driver);
+        return hash;
+    };
+
+    // Program must be created but not linked. Returns true if the cached binary was accepted.
+    bool load(uint64_t key, uint32_t program) const
+    {
+        if (!enabled)
+        {
+            return false;
+        }
+        std::filesystem::path path = file_path(key);
+        std::ifstream file{path, std::ios::binary};
+        if (!file)
+        {
+            return false;
+        }
+        Header header{};
+        file.read(reinterpret_cast<char *>(&header), sizeof(header));
+        std::vector<char> binary(file ? header.length : 0);
+        file.read(binary.data(), static_cast<std::streamsize>(binary.size()));
+        if (!file || header.magic != MAGIC)
+        {
+            remove(path);
+            return false;
+        }
+
+        glProgramBinary(program, header.format, binary.data(), static_cast<int32_t>(binary.size()));
+        int32_t status{0};
+        glGetProgramiv(program, GL_LINK_STATUS, &status);
+        if (!status)
+        {
+            Logger::get().info("Cached program binary rejected by the driver, recompiling");
+            remove(path);
+            return false;
+        }
+        return true;
+    };
+
+    // Program must have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set.
+    void store(uint64_t key, uint32_t program) const
+    {
+        if (!enabled)
+        {
+            return;
+        }
+        int32_t length{0};
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+        {
+            return;
+        }
+        std::vector<char> binary(static_cast<size_t>(length));
+        GLenum format{0};
+        glGetProgramBinary(program, length, &length, &format, binary.data());
+
+        std::filesystem::path path = file_path(key);
+        bool written = write_file_atomically(path, [&](std::ostream &file)
+        {
+            Header header{MAGIC, format, static_cast<uint32_t>(length), 0};
+            file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            file.write(binary.data(), length);
+        });
+        if (!written)
+        {
+            Logger::get().warning("Failed to write program binary {}", path.string());
+        }
+    };
+
+private:
+    std::filesystem::path file_path(uint64_t key) const
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+        return directory / name;
+    };
+
+    static void remove(const std::filesystem::path &path)
+    {
+        std::error_code error;
+        std::filesystem::remove(path, error);
+    };
+};
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef SHADER_LIBRARY_HPP
+#define SHADER_LIBRARY_HPP
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "shader.hpp"
+#include "shader_cache.hpp"
+#include "shader_preprocessor.hpp"
+
+// Owns one program per (vertex, fragment, defines) permutation. Requesting an existing permutation returns
+// the same Shader, a new one is submitted for compilation right away.
+class ShaderLibrary
+{
+private:
+    const ShaderCache *cache;
+    std::map<std::string, std::unique_ptr<Shader>> programs;
+
+public:
+    explicit ShaderLibrary(const ShaderCache *_cache = nullptr) : cache{_cache} {};
+    ShaderLibrary(const ShaderLibrary &) = delete;
+    ShaderLibrary &operator=(const ShaderLibrary &) = delete;
+
+    Shader &get(const std::string &vertex_name, const std::string &fragment_name, const ShaderDefines &defines = {})
+    {
+        return get(ShaderStages{{GL_VERTEX_SHADER, vertex_name}, {GL_FRAGMENT_SHADER, fragment_name}}, defines);
+    };
+
+    Shader &get(const ShaderStages &stages, const ShaderDefines &defines = {})
+    {
+        std::string key;
+        for (const auto &stage : stages)
+        {
+            key += stage.name + "|";
+        }
+        key += ShaderPreprocessor::defines_key(defines);
+        auto found = programs.find(key);
+        if (found == programs.end())
+        {
+            auto shader = std::make_unique<Shader>(stages, defines);
+            shader->submit(cache);
+            found = programs.emplace(key, std::move(shader)).first;
+        }
+        return *found->second;
+    };
+
+    std::vector<Shader *> all()
+    {
+        std::vector<Shader *> result;
+        result.reserve(programs.size());
+        for (auto &[key, shader] : programs)
+        {
+            result.push_back(shader.get());
+        }
+        return result;
+    };
+
+    // Polls every program so all of them make progress, see Shader::is_ready.
+    bool ready()
+    {
+        bool result{true};
+        for (auto &[key, shader] : programs)
+        {
+            result = shader->is_ready() && result;
+        }
+        return result;
+    };
+};
+
+#endif
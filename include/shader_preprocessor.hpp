@@ -0,0 +1,102 @@
+#ifndef SHADER_PREPROCESSOR_HPP
+#define SHADER_PREPROCESSOR_HPP
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "shader_sources.hpp"
+
+// Defines injected into a program, sorted so equal sets produce equal sources and cache keys.
+using ShaderDefines = std::map<std::string, std::string>;
+
+using ShaderSourceLoader = std::function<std::string(const std::string &name)>;
+
+struct PreprocessedShader
+{
+    std::string source;
+    // Every file that contributed, index i is source string number i in GLSL error messages.
+    std::vector<std::string> files;
+};
+
+// Resolves #include "name" (each file is included once) and injects defines right after #version.
+// #line directives keep compiler error messages pointing at the original file and line.
+class ShaderPreprocessor
+{
+public:
+    static PreprocessedShader process(const std::string &name, const ShaderDefines &defines, const ShaderSourceLoader &loader = read_shader_source)
+    {
+        PreprocessedShader result;
+        append_file(name, defines, loader, result, true);
+        return result;
+    };
+
+    static std::string defines_key(const ShaderDefines &defines)
+    {
+        std::string key;
+        for (const auto &[define, value] : defines)
+        {
+            key += define + "=" + value + ";";
+        }
+        return key;
+    };
+
+private:
+    static void append_file(const std::string &name, const ShaderDefines &defines, const ShaderSourceLoader &loader, PreprocessedShader &result, bool root)
+    {
+        if (std::find(result.files.begin(), result.files.end(), name) != result.files.end())
+        {
+            return;
+        }
+        size_t file_index = result.files.size();
+        result.files.push_back(name);
+
+        std::istringstream stream{loader(name)};
+        std::string line;
+        uint32_t line_number{0};
+        while (std::getline(stream, line))
+        {
+            line_number++;
+            size_t begin = line.find_first_not_of(" \t");
+            std::string_view directive = begin == std::string::npos ? std::string_view{} : std::string_view{line}.substr(begin);
+
+            if (directive.rfind("#version", 0) == 0)
+            {
+                if (root)
+                {
+                    result.source += line + "\n";
+                    for (const auto &[define, value] : defines)
+                    {
+                        result.source += "#define " + define + " " + value + "\n";
+                    }
+                    result.source += "#line " + std::to_string(line_number + 1) + " " + std::to_string(file_index) + "\n";
+                }
+                continue;
+            }
+
+            if (directive.rfind("#include", 0) == 0)
+            {
+                size_t open = directive.find('"');
+                size_t close = open == std::string_view::npos ? open : directive.find('"', open + 1);
+                if (close == std::string_view::npos)
+                {
+                    throw std::runtime_error("Malformed #include in " + name + ":" + std::to_string(line_number) + ".");
+                }
+                std::string included{directive.substr(open + 1, close - open - 1)};
+                result.source += "#line 1 " + std::to_string(result.files.size()) + "\n";
+                append_file(included, defines, loader, result, false);
+                result.source += "#line " + std::to_string(line_number + 1) + " " + std::to_string(file_index) + "\n";
+                continue;
+            }
+
+            result.source += line + "\n";
+        }
+    };
+};
+
+#endif
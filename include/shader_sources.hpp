@@ -0,0 +1,66 @@
+#ifndef SHADER_SOURCES_HPP
+#define SHADER_SOURCES_HPP
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "embedded_shaders.hpp"
+
+// Shaders are compiled into the executable from src/shaders (see cmake/embed_shaders.cmake) and looked up by
+// file name. Dev builds define SHADER_SOURCE_DIRECTORY, files found there take precedence over the
+// embedded copies so edits are picked up without rebuilding.
+
+inline bool shader_sources_on_disk()
+{
+#ifdef SHADER_SOURCE_DIRECTORY
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Directory the dev override reads from, empty in builds without it.
+inline std::filesystem::path shader_source_directory()
+{
+#ifdef SHADER_SOURCE_DIRECTORY
+    return std::filesystem::path{SHADER_SOURCE_DIRECTORY};
+#else
+    return {};
+#endif
+}
+
+inline const EmbeddedShader *find_embedded_shader(const std::string &name)
+{
+    for (const auto &shader : EMBEDDED_SHADERS)
+    {
+        if (shader.name == name)
+        {
+            return &shader;
+        }
+    }
+    return nullptr;
+}
+
+inline std::string read_shader_source(const std::string &name)
+{
+    if (shader_sources_on_disk())
+    {
+        std::ifstream file{shader_source_directory() / name};
+        if (file)
+        {
+            std::stringstream stream{};
+            stream << file.rdbuf();
+            return stream.str();
+        }
+    }
+    if (const EmbeddedShader *shader = find_embedded_shader(name))
+    {
+        return std::string{shader->source};
+    }
+    throw std::runtime_error("Unknown shader " + name + ".");
+}
+
+#endif
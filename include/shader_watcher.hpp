@@ -0,0 +1,270 @@
+#ifndef SHADER_WATCHER_HPP
+#define SHADER_WATCHER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "logger.hpp"
+#include "shader.hpp"
+#include "shader_cache.hpp"
+#include "shader_sources.hpp"
+
+struct ChangedSource
+{
+    std::filesystem::path path;
+    std::string source;
+};
+
+// Watches a directory on a background thread and reads every file that was modified. Uses inotify on Linux
+// and compares modification times twice a second elsewhere.
+class ShaderWatcher
+{
+public:
+    static constexpr std::chrono::milliseconds POLL_INTERVAL{100};
+    static constexpr std::chrono::milliseconds SETTLE_DELAY{30};
+
+    ShaderWatcher() = default;
+    ShaderWatcher(const ShaderWatcher &) = delete;
+    ShaderWatcher &operator=(const ShaderWatcher &) = delete;
+
+    ~ShaderWatcher()
+    {
+        stop();
+    };
+
+    void start(const std::filesystem::path &_directory)
+    {
+        if (thread.joinable())
+        {
+            return;
+        }
+        directory = _directory;
+        running.store(true, std::memory_order_release);
+        thread = std::thread{&ShaderWatcher::watch, this};
+    };
+
+    void stop()
+    {
+        running.store(false, std::memory_order_release);
+        if (thread.joinable())
+        {
+            thread.join();
+        }
+    };
+
+    std::vector<ChangedSource> take_changes()
+    {
+        std::lock_guard<std::mutex> lock{changes_mutex};
+        return std::move(changes);
+    };
+
+private:
+    std::filesystem::path directory;
+    std::atomic<bool> running{false};
+    std::thread thread;
+    std::mutex changes_mutex;
+    std::vector<ChangedSource> changes;
+
+    void publish(const std::vector<std::filesystem::path> &paths)
+    {
+        // Editors often write a file in several steps, give them a moment before reading.
+        std::this_thread::sleep_for(SETTLE_DELAY);
+        std::vector<ChangedSource> sources;
+        for (const auto &path : paths)
+        {
+            std::ifstream file{path};
+            if (!file)
+            {
+                continue;
+            }
+            std::stringstream stream;
+            stream << file.rdbuf();
+            sources.push_back(ChangedSource{path, stream.str()});
+        }
+        std::lock_guard<std::mutex> lock{changes_mutex};
+        for (auto &source : sources)
+        {
+            changes.push_back(std::move(source));
+        }
+    };
+
+#ifdef __linux__
+    void watch()
+    {
+        int descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (descriptor < 0 || inotify_add_watch(descriptor, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+        {
+            Logger::get().error("Failed to watch {} for shader changes", directory.string());
+            if (descriptor >= 0)
+            {
+                close(descriptor);
+            }
+            return;
+        }
+
+        alignas(inotify_event) char buffer[4096];
+        while (running.load(std::memory_order_acquire))
+        {
+            pollfd request{descriptor, POLLIN, 0};
+            if (poll(&request, 1, static_cast<int>(POLL_INTERVAL.count())) <= 0)
+            {
+                continue;
+            }
+            std::vector<std::filesystem::path> paths;
+            ssize_t length;
+            while ((length = read(descriptor, buffer, sizeof(buffer))) > 0)
+            {
+                for (char *pointer = buffer; pointer < buffer + length;)
+                {
+                    const inotify_event *event = reinterpret_cast<const inotify_event *>(pointer);
+                    if (event->len > 0)
+                    {
+                        std::filesystem::path path = directory / event->name;
+                        if (std::find(paths.begin(), paths.end(), path) == paths.end())
+                        {
+                            paths.push_back(path);
+                        }
+                    }
+                    pointer += sizeof(inotify_event) + event->len;
+                }
+            }
+            publish(paths);
+        }
+        close(descriptor);
+    };
+#else
+    void watch()
+    {
+        std::map<std::filesystem::path, std::filesystem::file_time_type> times;
+        auto scan = [&](std::vector<std::filesystem::path> *modified)
+        {
+            std::error_code error;
+            for (const auto &entry : std::filesystem::directory_iterator{directory, error})
+            {
+                auto time = entry.last_write_time(error);
+                auto found = times.find(entry.path());
+                if (modified != nullptr && (found == times.end() || found->second != time))
+                {
+                    modified->push_back(entry.path());
+                }
+                times[entry.path()] = time;
+            }
+        };
+        scan(nullptr);
+        uint32_t ticks{0};
+        while (running.load(std::memory_order_acquire))
+        {
+            std::this_thread::sleep_for(POLL_INTERVAL);
+            if (++ticks % 5 != 0)
+            {
+                continue;
+            }
+            std::vector<std::filesystem::path> paths;
+            scan(&paths);
+            if (!paths.empty())
+            {
+                publish(paths);
+            }
+        }
+    };
+#endif
+};
+
+// Rebuilds programs whose sources or includes changed and swaps them into the live Shader only once they have linked
+// successfully, a broken edit keeps the previous program running.
+class ShaderHotReload
+{
+public:
+    void watch(const std::filesystem::path &directory)
+    {
+        watcher.start(directory);
+    };
+
+    void add(Shader *shader)
+    {
+        shaders.push_back(shader);
+    };
+
+    // Call once per frame on the thread that owns the GL context.
+    void update(const ShaderCache *cache)
+    {
+        for (auto &change : watcher.take_changes())
+        {
+            std::string name{change.path.filename().string()};
+            sources[name] = std::move(change.source);
+            for (Shader *shader : shaders)
+            {
+                if (!shader->depends_on(name))
+                {
+                    continue;
+                }
+                // Unchanged files come from the sources seen so far, so only modified files are read again.
+                auto replacement = std::make_unique<Shader>(shader->get_stages(), shader->get_defines());
+                try
+                {
+                    replacement->submit(cache, [this](const std::string &file) { return load_source(file); });
+                }
+                catch (const std::exception &e)
+                {
+                    Logger::get().error("Shader reload failed, keeping the previous program: {}", e.what());
+                    continue;
+                }
+                reloads[shader] = std::move(replacement);
+                Logger::get().info("Recompiling {}", shader->get_name());
+            }
+        }
+
+        for (auto it = reloads.begin(); it != reloads.end();)
+        {
+            try
+            {
+                if (!it->second->is_ready())
+                {
+                    ++it;
+                    continue;
+                }
+                *it->first = std::move(*it->second);
+                Logger::get().info("Reloaded {}", it->first->get_name());
+            }
+            catch (const std::exception &e)
+            {
+                Logger::get().error("Shader reload failed, keeping the previous program: {}", e.what());
+            }
+            it = reloads.erase(it);
+        }
+    };
+
+private:
+    ShaderWatcher watcher;
+    std::vector<Shader *> shaders;
+    std::map<Shader *, std::unique_ptr<Shader>> reloads;
+    std::map<std::string, std::string> sources;
+
+    const std::string &load_source(const std::string &name)
+    {
+        auto found = sources.find(name);
+        if (found == sources.end())
+        {
+            found = sources.emplace(name, read_shader_source(name)).first;
+        }
+        return found->second;
+    };
+};
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef STATIC_BATCHER_HPP
+#define STATIC_BATCHER_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "mesh.hpp"
+#include "model.hpp"
+#include "profiler.hpp"
+#include "thread_pool.hpp"
+#include "transform.hpp"
+
+// Bakes objects that never move into a few large indexed drawables. Objects are grouped by color, the
+// only per draw state of the scene shaders, and by the grid cell of their position, so every batch keeps
+// tight bounds for culling. The vertices are transformed to world space on the thread pool and a batch
+// is drawn with an identity model matrix in one call.
+class StaticBatcher
+{
+public:
+    // Larger batches are split, a batch stays within what a 32 bit index can address many times over.
+    static constexpr size_t MAX_BATCH_VERTICES{1 << 20};
+
+    explicit StaticBatcher(float _cell_size) : cell_size{_cell_size} {};
+
+    // The mesh must stay alive until build() returns, any number of objects can share one.
+    void add(const Mesh &mesh, const glm::vec3 &color, const Transform &transform)
+    {
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), transform.translate);
+        model = glm::rotate(model, transform.angle, transform.rotate_axis);
+        model = glm::scale(model, transform.scale);
+        glm::ivec3 cell{glm::floor(transform.translate / cell_size)};
+        objects.push_back(Object{&mesh, color, model, cell, 0, 0, 0});
+    };
+
+    size_t object_count() const { return objects.size(); };
+
+    // Creates one drawable per batch and forgets the objects. Runs on the GL thread, only the baking of
+    // the vertices is spread over the workers.
+    std::vector<std::unique_ptr<ModelIndexed>> build(const glm::mat4 &view, const glm::mat4 &projection, MeshResidency residency = MeshResidency::bounds_only)
+    {
+        PROFILE_FUNCTION();
+        auto key = [](const Object &object)
+        {
+            return std::make_tuple(object.color.x, object.color.y, object.color.z, object.cell.x, object.cell.y, object.cell.z);
+        };
+        std::sort(objects.begin(), objects.end(), [&key](const Object &a, const Object &b) { return key(a) < key(b); });
+
+        // Ranges of the batch meshes, assigned in order so every object knows where its data goes.
+        std::vector<Mesh> meshes;
+        size_t vertex_count{0};
+        size_t index_count{0};
+        for (size_t i = 0; i < objects.size(); i++)
+        {
+            Object &object = objects[i];
+            bool new_batch = i == 0 || key(objects[i - 1]) != key(object) || vertex_count + object.mesh->vertices.size() > MAX_BATCH_VERTICES;
+            if (new_batch)
+            {
+                close_batch(meshes, vertex_count, index_count);
+                meshes.emplace_back();
+                meshes.back().color = object.color;
+                vertex_count = 0;
+                index_count = 0;
+            }
+            object.batch = static_cast<uint32_t>(meshes.size() - 1);
+            object.first_vertex = vertex_count;
+            object.first_index = index_count;
+            vertex_count += object.mesh->vertices.size();
+            index_count += object.mesh->indices.size();
+        }
+        close_batch(meshes, vertex_count, index_count);
+
+        ThreadPool::get().parallel_for(objects.size(), 64, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; i++)
+            {
+                bake(objects[i], meshes[objects[i].batch]);
+            }
+        });
+
+        std::vector<std::unique_ptr<ModelIndexed>> batches;
+        batches.reserve(meshes.size());
+        const Transform identity{glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f), 0.0f, glm::vec3(1.0f)};
+        for (auto &mesh : meshes)
+        {
+            batches.push_back(std::make_unique<ModelIndexed>(std::move(mesh), identity, view, projection, residency));
+        }
+        objects.clear();
+        return batches;
+    };
+
+private:
+    struct Object
+    {
+        const Mesh *mesh;
+        glm::vec3 color;
+        glm::mat4 model;
+        glm::ivec3 cell;
+        uint32_t batch;
+        size_t first_vertex;
+        size_t first_index;
+    };
+
+    float cell_size;
+    std::vector<Object> objects;
+
+    static void close_batch(std::vector<Mesh> &meshes, size_t vertex_count, size_t index_count)
+    {
+        if (!meshes.empty())
+        {
+            meshes.back().vertices.resize(vertex_count);
+            meshes.back().indices.resize(index_count);
+        }
+    };
+
+    // Normals go through the inverse transpose, so non uniform scales keep them perpendicular.
+    static void bake(const Object &object, Mesh &batch)
+    {
+        glm::mat3 normal_matrix = glm::transpose(glm::inverse(glm::mat3(object.model)));
+        const Mesh &mesh = *object.mesh;
+        Vertex *vertices = batch.vertices.data() + object.first_vertex;
+        for (size_t v = 0; v < mesh.vertices.size(); v++)
+        {
+            vertices[v].position = glm::vec3(object.model * glm::vec4(mesh.vertices[v].position, 1.0f));
+            glm::vec3 normal = normal_matrix * mesh.vertices[v].normal;
+            float length = glm::length(normal);
+            vertices[v].normal = length > 0.0f ? normal / length : normal;
+        }
+        int32_t *indices = batch.indices.data() + object.first_index;
+        int32_t offset = static_cast<int32_t>(object.first_vertex);
+        for (size_t i = 0; i < mesh.indices.size(); i++)
+        {
+            indices[i] = mesh.indices[i] + offset;
+        }
+    };
+};
+
+#endif
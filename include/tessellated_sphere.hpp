@@ -0,0 +1,63 @@
+#ifndef TESSELLATED_SPHERE_HPP
+#define TESSELLATED_SPHERE_HPP
+
+#include <cstdint>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "glad_extensions.hpp"
+#include "mesh.hpp"
+#include "model.hpp"
+#include "shader.hpp"
+
+// Sphere drawn from an icosahedron as 20 triangle patches. sphere_tess.tesc subdivides every edge until
+// it covers about edge_pixels on screen and sphere_tess.tese pushes the new vertices onto the sphere, so
+// the triangle density follows the projected size while the buffers stay at 12 vertices. The radius is
+// the transform's scale. Needs GL 4.0, see GladExtensions::tessellation.
+class TessellatedSphere : public Drawable
+{
+private:
+    uint32_t EBO;
+
+public:
+    static constexpr int32_t PATCH_VERTICES{3};
+
+    TessellatedSphere(const glm::vec3& color, const Transform& transform, const glm::mat4& view, const glm::mat4& projection)
+        : Drawable{Bounds{glm::vec3(-1.0f), glm::vec3(1.0f)}, color, transform, view, projection}
+    {
+        Mesh base = get_icosahedron_mesh(1.0f, color);
+        vertex_count = static_cast<uint32_t>(base.vertices.size());
+        index_count = static_cast<uint32_t>(base.indices.size());
+        create_vertex_buffer(base.vertices.data(), sizeof(Vertex) * base.vertices.size());
+
+        glGenBuffers(1, &EBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(int32_t) * base.indices.size(), base.indices.data(), GL_STATIC_DRAW);
+    };
+    TessellatedSphere(const TessellatedSphere&) = delete;
+    TessellatedSphere& operator=(const TessellatedSphere&) = delete;
+    ~TessellatedSphere() override
+    {
+        glDeleteBuffers(1, &EBO);
+    };
+
+    // The shader sets up the tessellation, its per frame uniforms come from set_view_parameters().
+    static void set_view_parameters(Shader& shader, int32_t viewport_height, float edge_pixels)
+    {
+        shader.use();
+        shader.set_float("viewport_half_height", viewport_height * 0.5f);
+        shader.set_float("edge_pixels", edge_pixels);
+    };
+
+    void draw(Shader& shader) override
+    {
+        glBindVertexArray(VAO);
+        shader.use();
+        set_transform(shader);
+        glPatchParameteri(GL_PATCH_VERTICES, PATCH_VERTICES);
+        glDrawElements(GL_PATCHES, static_cast<int32_t>(index_count), GL_UNSIGNED_INT, nullptr);
+    };
+};
+
+#endif
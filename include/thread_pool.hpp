@@ -0,0 +1,162 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed set of worker threads shared by everything that splits CPU work: parallel_for for data parallel
+// loops on the calling thread's behalf, submit for fire-and-forget background jobs.
+class ThreadPool
+{
+public:
+    static ThreadPool &get()
+    {
+        static ThreadPool pool{std::max(1u, std::thread::hardware_concurrency()) - 1};
+        return pool;
+    };
+
+    explicit ThreadPool(size_t thread_count)
+    {
+        for (size_t i = 0; i < thread_count; i++)
+        {
+            workers.emplace_back(&ThreadPool::worker_loop, this, i + 1);
+        }
+    };
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock{tasks_mutex};
+            stopping = true;
+        }
+        tasks_condition.notify_all();
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+    };
+
+    size_t thread_count() const { return workers.size(); };
+
+    // 1 to thread_count() on the workers, 0 on every other thread.
+    static size_t thread_index() { return current_thread_index(); };
+
+    template <typename Function>
+    auto submit(Function &&function) -> std::future<std::invoke_result_t<Function>>
+    {
+        using Result = std::invoke_result_t<Function>;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Function>(function));
+        std::future<Result> result = task->get_future();
+        push([task] { (*task)(); });
+        return result;
+    };
+
+    // Calls body(begin, end) over [0, count) split into ranges of at least grain items. The calling thread
+    // works on ranges too and the call returns once all of them are done.
+    template <typename Body>
+    void parallel_for(size_t count, size_t grain, Body &&body)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+        grain = std::max<size_t>(grain, 1);
+        size_t range_count = std::min((count + grain - 1) / grain, (workers.size() + 1) * 4);
+        if (range_count <= 1 || workers.empty())
+        {
+            body(size_t{0}, count);
+            return;
+        }
+
+        struct Job
+        {
+            std::atomic<size_t> next{0};
+            std::atomic<size_t> remaining;
+            std::mutex mutex;
+            std::condition_variable done;
+        };
+        auto job = std::make_shared<Job>();
+        job->remaining.store(range_count, std::memory_order_relaxed);
+
+        auto run = [job, count, range_count, &body]
+        {
+            size_t range;
+            while ((range = job->next.fetch_add(1, std::memory_order_relaxed)) < range_count)
+            {
+                body(count * range / range_count, count * (range + 1) / range_count);
+                if (job->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                {
+                    std::lock_guard<std::mutex> lock{job->mutex};
+                    job->done.notify_all();
+                }
+            }
+        };
+
+        size_t helpers = std::min(workers.size(), range_count - 1);
+        for (size_t i = 0; i < helpers; i++)
+        {
+            push(run);
+        }
+        run();
+
+        std::unique_lock<std::mutex> lock{job->mutex};
+        job->done.wait(lock, [&job] { return job->remaining.load(std::memory_order_acquire) == 0; });
+    };
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex tasks_mutex;
+    std::condition_variable tasks_condition;
+    std::deque<std::function<void()>> tasks;
+    bool stopping{false};
+
+    void push(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock{tasks_mutex};
+            tasks.push_back(std::move(task));
+        }
+        tasks_condition.notify_one();
+    };
+
+    static size_t &current_thread_index()
+    {
+        static thread_local size_t index{0};
+        return index;
+    };
+
+    void worker_loop(size_t index)
+    {
+        current_thread_index() = index;
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock{tasks_mutex};
+                tasks_condition.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (stopping && tasks.empty())
+                {
+                    return;
+                }
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    };
+};
+
+#endif
@@ -1,7 +1,14 @@
 #include <iostream>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <cstdlib>
+#include <new>
 #include <vector>
+#include <filesystem>
 #include <fstream>
+#include <functional>
+#include <future>
 #include <sstream>
 #include <string>
 
@@ -10,17 +17,100 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "asset_streamer.hpp"
+#include "clustered_lighting.hpp"
+#include "deferred_shading.hpp"
+#include "frame_arena.hpp"
+#include "frame_capture.hpp"
+#include "glad_extensions.hpp"
+#include "gpu_driven_scene.hpp"
+#include "gpu_timer.hpp"
+#include "logger.hpp"
+#include "mesh_codec.hpp"
+#include "mesh_file.hpp"
+#include "mesh_loader.hpp"
+#include "mesh_simplifier.hpp"
+#include "meshlets.hpp"
+#include "occlusion_culler.hpp"
+#include "point_shadow_map.hpp"
+#include "profiler.hpp"
 #include "shader.hpp"
+#include "shader_cache.hpp"
+#include "shader_library.hpp"
+#include "shader_watcher.hpp"
+#include "static_batcher.hpp"
+#include "tessellated_sphere.hpp"
 #include "model.hpp"
 
 const std::string WINDOW_NAME{"OpenGL"};
 constexpr int32_t WIDTH{1280};
 constexpr int32_t HEIGHT{720};
+const std::string TRACE_PATH{"trace.json"};
+constexpr uint32_t TRACE_FRAME_COUNT{300};
+const std::string CAPTURE_DIRECTORY{"captures"};
+const std::string SHADER_CACHE_DIRECTORY{"shader_cache"};
+const std::string MESH_DIRECTORY{"meshes"};
+constexpr float FIELD_OF_VIEW{45.0f};
+constexpr float Z_NEAR{0.1f};
+constexpr float Z_FAR{100.0f};
+constexpr uint32_t CLUSTERED_LIGHT_COUNT{256};
+constexpr uint32_t SHADOW_MAP_RESOLUTION{1024};
+constexpr float SHADOW_NEAR_PLANE{0.01f};
+constexpr float SHADOW_FAR_PLANE{10.0f};
+// Side of the grid of small spheres drawn by the GPU driven path.
+constexpr uint32_t GPU_DRIVEN_GRID_SIZE{256};
+// Detailed spheres streamed in behind the scene, and the upload budget they share.
+constexpr uint32_t STREAMED_OBJECT_COUNT{64};
+constexpr size_t STREAMING_BYTES_PER_FRAME{4 * 1024 * 1024};
+constexpr double STREAMING_MILLISECONDS_PER_FRAME{1.0};
+// Pebbles scattered over the ground, baked into static batches of STATIC_BATCH_CELL_SIZE wide cells.
+constexpr uint32_t STATIC_OBJECT_COUNT{3000};
+constexpr float STATIC_BATCH_CELL_SIZE{0.5f};
+// Spheres tessellated on the GPU at growing distances, and the projected length their edges aim for.
+constexpr uint32_t TESSELLATED_SPHERE_COUNT{5};
+constexpr float TESSELLATION_EDGE_PIXELS{8.0f};
+// Segments of the main sphere, split into meshlets of MeshletBuilder::MAX_TRIANGLES triangles.
+constexpr uint32_t MESHLET_SPHERE_SEGMENTS{64};
+// The volume sphere is a coarse polygon inscribed in the unit sphere, scaled up so it still covers the light radius.
+constexpr float LIGHT_VOLUME_SCALE{1.1f};
+
+#if PROFILING_ENABLED
+// Heap allocations of all threads, F2 reports how many the last frame made.
+std::atomic<uint64_t> heap_allocation_count{0};
+
+void *operator new(size_t size)
+{
+    heap_allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void *pointer = std::malloc(size == 0 ? 1 : size))
+    {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept
+{
+    std::free(pointer);
+}
+#endif
+
+// How the point lights reach the sphere, cycled with F4.
+enum class LightingPath
+{
+    forward,
+    clustered,
+    deferred,
+};
 
 class OpenGlApp
 {
 public:
-    OpenGlApp(const std::string &_window_name, int32_t _width, int32_t _height) : window_name{_window_name}, width{_width}, height{_height} {};
+    OpenGlApp(const std::string &_window_name, int32_t _width, int32_t _height, const std::string &_mesh_path) : window_name{_window_name}, width{_width}, height{_height}, mesh_path{_mesh_path} {};
 
     void run()
     {
@@ -33,6 +123,7 @@ public:
 
     ~OpenGlApp()
     {
+        frame_capture.stop();
         glfwDestroyWindow(window);
         glfwTerminate();
     };
@@ -41,15 +132,28 @@ private:
     const std::string window_name;
     int32_t width;
     int32_t height;
+    // OBJ or glTF file drawn in place of the main sphere, empty for the sphere.
+    const std::string mesh_path;
 
     GLFWwindow *window;
 
-    Shader sphere_shader;
-    Shader light_shader;
+    ShaderCache shader_cache{SHADER_CACHE_DIRECTORY};
+    ShaderLibrary shader_library{&shader_cache};
+    ShaderHotReload shader_hot_reload;
+    Shader *sphere_shader{};
+    Shader *light_shader{};
+
+    // Specialization of frag_shader.frag used for the lit sphere, see lighting.glsl for the options.
+    ShaderDefines sphere_defines{
+        {"LIGHT_COUNT", "1"},
+        {"SPECULAR", "1"},
+        {"SHADING_MODEL", "SHADING_PHONG"},
+        {"SHADOWS", "1"},
+    };
 
     std::vector<std::pair<const std::string, const std::string>> shaders_paths{
-        {"../../src/shaders/vert_shader.vert", "../../src/shaders/frag_shader.frag"},
-        {"../../src/shaders/light_shader.vert", "../../src/shaders/light_shader.frag"},
+        {"vert_shader.vert", "frag_shader.frag"},
+        {"light_shader.vert", "light_shader.frag"},
     };
 
     glm::vec3 camera_pos{0.0f, 0.0f, -1.0f};
@@ -60,21 +164,117 @@ private:
     float delta_time = 0.0f;
     float last_time = 0.0f;
 
-    std::unique_ptr<Drawable> sphere;
+    bool shaders_loaded = false;
+    bool capture_key_was_pressed = false;
+    bool report_key_was_pressed = false;
+    uint64_t frame_allocations{0};
+    bool frame_capture_key_was_pressed = false;
+    bool lighting_path_key_was_pressed = false;
+    bool depth_prepass_key_was_pressed = false;
+    bool shadows_key_was_pressed = false;
+    bool gpu_driven_key_was_pressed = false;
+    bool occlusion_culling_key_was_pressed = false;
+    bool meshlet_culling_key_was_pressed = false;
+    bool tessellation_key_was_pressed = false;
+
+    GpuTimer gpu_timer;
+    FrameCapture frame_capture;
+
+    // Forward paths lay down depth first with a position only program so the lit pass shades each pixel once, F5.
+    bool depth_prepass_enabled = false;
+    Shader *depth_only_shader{};
+
+    // Cube shadow map of the main light, cached between frames, F6.
+    bool shadows_enabled = true;
+    Shader *shadow_shader{};
+    PointShadowMap shadow_map;
+
+    // Field of instances culled and drawn entirely on the GPU, F7. Only available on GL 4.3 contexts.
+    bool gpu_driven_enabled = false;
+    // Set once the scene has its LODs, a loaded mesh is simplified in the background first.
+    bool gpu_driven_ready = false;
+    std::future<std::vector<Mesh>> gpu_driven_lods;
+    Shader *gpu_cull_shader{};
+    Shader *depth_pyramid_shader{};
+    Shader *gpu_driven_shader{};
+    GpuDrivenScene gpu_driven_scene;
+
+    // CPU occlusion culling of the small drawables against the sphere and the ground, F8.
+    bool occlusion_culling_enabled = true;
+    OcclusionCuller occlusion_culler;
+
+    // Many small moving point lights, shaded through ClusteredLighting or DeferredShading.
+    LightingPath lighting_path = LightingPath::forward;
+    Shader *clustered_sphere_shader{};
+    ClusteredLighting clustered_lighting;
+    Shader *gbuffer_shader{};
+    Shader *deferred_ambient_shader{};
+    Shader *deferred_light_shader{};
+    DeferredShading deferred_shading;
+    std::vector<PointLight> point_lights;
+    std::vector<glm::vec4> point_light_orbits;
+
+    // Split into meshlets that are frustum and backface culled as a whole, F9.
+    bool meshlet_culling_enabled = true;
+    std::unique_ptr<MeshletModel> sphere;
     std::unique_ptr<Drawable> sphere2;
+    std::unique_ptr<Drawable> ground;
+    std::unique_ptr<Drawable> light_marker;
+    std::unique_ptr<Drawable> light_volume;
+
+    // Objects loaded on the workers and uploaded a few per frame, drawn as stream_placeholder until resident.
+    AssetStreamer asset_streamer{STREAMING_BYTES_PER_FRAME, STREAMING_MILLISECONDS_PER_FRAME};
+    std::unique_ptr<Drawable> stream_placeholder;
+    std::vector<std::unique_ptr<StreamedModel>> streamed_models;
+
+    // Spheres whose detail follows their size on screen, F10. Only available on GL 4.0 contexts.
+    bool tessellation_enabled = true;
+    Shader *tessellated_sphere_shader{};
+    std::vector<std::unique_ptr<TessellatedSphere>> tessellated_spheres;
+
+    // Objects that never move, drawn as a few pre-transformed batches.
+    std::vector<std::unique_ptr<ModelIndexed>> static_batches;
+    size_t static_object_count{0};
 
     void main_loop()
     {
         while (!glfwWindowShouldClose(window))
         {
+            PROFILE_BEGIN_FRAME();
+            FrameArena::get().begin_frame();
+#if PROFILING_ENABLED
+            uint64_t allocations_before = heap_allocation_count.load(std::memory_order_relaxed);
+#endif
+
             update_variables();
+            poll_gpu_driven_scene();
 
             process_input();
 
-            render();
+            shader_hot_reload.update(&shader_cache);
+            if (!shaders_loaded)
+            {
+                shaders_loaded = shader_library.ready();
+            }
+            if (shaders_loaded)
+            {
+                render();
+            }
+            else
+            {
+                render_loading();
+            }
 
-            glfwSwapBuffers(window);
+            frame_capture.capture();
+
+            {
+                PROFILE_SCOPE("glfwSwapBuffers");
+                glfwSwapBuffers(window);
+            }
             glfwPollEvents();
+#if PROFILING_ENABLED
+            frame_allocations = heap_allocation_count.load(std::memory_order_relaxed) - allocations_before;
+#endif
         }
     };
 
@@ -89,7 +289,7 @@ private:
     void init_glfw()
     {
         glfwInit();
-        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
         glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
         glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     };
@@ -98,6 +298,13 @@ private:
     {
         window = glfwCreateWindow(width, height, window_name.c_str(), nullptr, nullptr);
         if (window == nullptr)
+        {
+            // GL 4.3 only enables optional paths, everything else runs on 3.3.
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+            window = glfwCreateWindow(width, height, window_name.c_str(), nullptr, nullptr);
+        }
+        if (window == nullptr)
         {
             throw std::runtime_error("Failed to create window.");
         }
@@ -112,6 +319,7 @@ private:
         {
             throw std::runtime_error("Failed to initialize GLAD.");
         }
+        load_glad_extensions((GLADloadproc)glfwGetProcAddress);
     };
 
     void set_opengl_parameters()
@@ -122,17 +330,54 @@ private:
 
     void create_shaders()
     {
-        sphere_shader = Shader(shaders_paths[0].first, shaders_paths[0].second);
-        sphere_shader.init();
+        shader_cache.init();
+        if (GLAD_EXTENSIONS.parallel_shader_compile)
+        {
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        }
+
+        sphere_shader = &shader_library.get(shaders_paths[0].first, shaders_paths[0].second, sphere_defines);
+        light_shader = &shader_library.get(shaders_paths[1].first, shaders_paths[1].second);
+        clustered_sphere_shader = &shader_library.get(shaders_paths[0].first, shaders_paths[0].second, ClusteredLighting::shader_defines(sphere_defines));
+        depth_only_shader = &shader_library.get("depth_only.vert", "depth_only.frag");
+        shadow_shader = &shader_library.get(ShaderStages{
+            {GL_VERTEX_SHADER, "shadow.vert"},
+            {GL_GEOMETRY_SHADER, "shadow.geom"},
+            {GL_FRAGMENT_SHADER, "shadow.frag"},
+        });
+        if (GLAD_EXTENSIONS.gpu_driven)
+        {
+            gpu_cull_shader = &shader_library.get(ShaderStages{{GL_COMPUTE_SHADER, "gpu_cull.comp"}}, GpuDrivenScene::shader_defines());
+            depth_pyramid_shader = &shader_library.get(ShaderStages{{GL_COMPUTE_SHADER, "depth_pyramid.comp"}});
+            gpu_driven_shader = &shader_library.get("gpu_driven.vert", shaders_paths[0].second, sphere_defines);
+        }
+        if (GLAD_EXTENSIONS.tessellation)
+        {
+            tessellated_sphere_shader = &shader_library.get(ShaderStages{
+                {GL_VERTEX_SHADER, "sphere_tess.vert"},
+                {GL_TESS_CONTROL_SHADER, "sphere_tess.tesc"},
+                {GL_TESS_EVALUATION_SHADER, "sphere_tess.tese"},
+                {GL_FRAGMENT_SHADER, shaders_paths[0].second},
+            }, sphere_defines);
+        }
+        gbuffer_shader = &shader_library.get("vert_shader.vert", "gbuffer.frag");
+        deferred_ambient_shader = &shader_library.get("fullscreen.vert", "deferred_ambient.frag", sphere_defines);
+        deferred_light_shader = &shader_library.get("light_shader.vert", "deferred_light.frag", sphere_defines);
 
-        light_shader = Shader(shaders_paths[1].first, shaders_paths[1].second);
-        light_shader.init();
+        for (Shader *shader : shader_library.all())
+        {
+            shader_hot_reload.add(shader);
+        }
+        if (shader_sources_on_disk())
+        {
+            shader_hot_reload.watch(shader_source_directory());
+        }
     };
 
     void create_mvp_matrices()
     {
         view = glm::translate(glm::mat4(1.0f), camera_pos);
-        projection = glm::perspective(glm::radians(45.0f), width / static_cast<float>(height), 0.1f, 100.0f);
+        projection = glm::perspective(glm::radians(FIELD_OF_VIEW), width / static_cast<float>(height), Z_NEAR, Z_FAR);
     }
 
     void create_objects()
@@ -141,51 +386,616 @@ private:
         uint32_t ring_segments = 16;
         float radius = 0.5f;
 
-        Mesh sphere_mesh = get_sphere_mesh(segments, ring_segments, radius, glm::vec3{0.5f, 0.1f, 0.2f});
+        // A loaded mesh is read once at unit radius, the main sphere gets a scaled copy and the GPU driven
+        // scene simplifies the original.
+        Mesh scene_mesh = mesh_path.empty() ? Mesh{} : load_scene_mesh(1.0f);
+        // The main sphere is detailed enough for its meshlets to be worth culling, the light sphere stays coarse.
+        Mesh sphere_mesh = mesh_path.empty() ? get_sphere_mesh(MESHLET_SPHERE_SEGMENTS, MESHLET_SPHERE_SEGMENTS, radius, glm::vec3{0.5f, 0.1f, 0.2f}) : scene_mesh;
+        if (!mesh_path.empty())
+        {
+            for (auto &vertex : sphere_mesh.vertices)
+            {
+                vertex.position *= radius;
+            }
+        }
+        Mesh sphere2_mesh = mesh_path.empty() ? get_sphere_mesh(segments, ring_segments, radius, glm::vec3{0.5f, 0.1f, 0.2f}) : sphere_mesh;
         Transform transform{glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f), 0.0f, glm::vec3(0.3f)};
-        sphere = std::make_unique<ModelIndexed>(sphere_mesh, transform, view, projection);
+        // The sphere and the ground are occluders, the occlusion culler rasterizes their CPU side geometry.
+        sphere = std::make_unique<MeshletModel>(std::move(sphere_mesh), transform, view, projection, MeshResidency::keep);
+        sphere->set_culling(meshlet_culling_enabled);
 
         transform.translate = glm::vec3(-0.5f, 0.0f, 0.0f);
-        sphere2 = std::make_unique<ModelIndexed>(sphere_mesh, transform, view, projection);
+        sphere2 = std::make_unique<ModelIndexed>(std::move(sphere2_mesh), transform, view, projection);
+
+        Mesh ground_mesh = get_plane_mesh(2.0f, glm::vec3{0.4f, 0.4f, 0.4f});
+        ground = std::make_unique<ModelIndexed>(std::move(ground_mesh), Transform{glm::vec3(0.0f, -0.3f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), 0.0f, glm::vec3(1.0f)}, view, projection,
+                                                MeshResidency::keep);
+
+        // Volumes and markers come from a baked file, LOD 0 keeps the 16x16 sphere LIGHT_VOLUME_SCALE is tuned for.
+        MeshFile unit_sphere = open_baked_mesh("unit_sphere.mesh", [] {
+            std::vector<Mesh> lods;
+            for (uint32_t lod_segments : {16u, 8u, 4u})
+            {
+                lods.push_back(get_sphere_mesh(lod_segments, lod_segments, 1.0f, glm::vec3{1.0f}));
+            }
+            return lods;
+        });
+        transform.scale = glm::vec3(0.01f);
+        light_marker = std::make_unique<MeshFileModel>(unit_sphere, 1, transform, view, projection);
+        light_volume = std::make_unique<MeshFileModel>(unit_sphere, 0, transform, view, projection);
+        stream_placeholder = std::make_unique<MeshFileModel>(unit_sphere, 2, transform, view, projection);
+        create_streamed_objects();
+        create_static_objects();
+        if (GLAD_EXTENSIONS.tessellation)
+        {
+            // A row receding from the camera, the far ones end up with a fraction of the near ones' triangles.
+            for (uint32_t i = 0; i < TESSELLATED_SPHERE_COUNT; i++)
+            {
+                Transform sphere_transform{glm::vec3(0.75f, 0.15f, -0.5f - 2.0f * i), glm::vec3(0.0f, 1.0f, 0.0f), 0.0f, glm::vec3(0.15f)};
+                tessellated_spheres.push_back(std::make_unique<TessellatedSphere>(glm::vec3{0.3f, 0.4f, 0.8f}, sphere_transform, view, projection));
+            }
+        }
+
+        create_point_lights();
+        deferred_shading.init(width, height);
+
+        shadow_map.init(SHADOW_MAP_RESOLUTION, SHADOW_NEAR_PLANE, SHADOW_FAR_PLANE);
+        shadow_map.add_caster(sphere.get(), false);
+        shadow_map.add_caster(ground.get(), true);
+        for (auto &batch : static_batches)
+        {
+            shadow_map.add_caster(batch.get(), true);
+        }
+
+        if (GLAD_EXTENSIONS.gpu_driven)
+        {
+            create_gpu_driven_scene(std::move(scene_mesh));
+        }
+    };
+
+    // Two rows of detailed spheres resting on the ground behind the main sphere. Each one is read from a
+    // compressed file and decoded on a worker, then reaches the GPU through the streamer's upload budget.
+    void create_streamed_objects()
+    {
+        asset_streamer.init();
+        std::filesystem::path sphere_path = std::filesystem::path{MESH_DIRECTORY} / "streamed_sphere.meshz";
+        if (!MeshCodec::is_current(sphere_path))
+        {
+            MeshCodec::write(sphere_path, get_sphere_mesh(96, 96, 1.0f, glm::vec3{1.0f}));
+        }
+        for (uint32_t i = 0; i < STREAMED_OBJECT_COUNT; i++)
+        {
+            uint32_t row = i % 2;
+            float x = -1.6f + 3.2f * (i / 2) / (STREAMED_OBJECT_COUNT / 2 - 1);
+            Transform transform{glm::vec3(x, -0.25f, -0.8f - 0.3f * row), glm::vec3(0.0f, 1.0f, 0.0f), 0.0f, glm::vec3(0.05f)};
+            glm::vec3 color{0.3f + 0.6f * (i % 3) / 2.0f, 0.4f, 0.9f - 0.6f * (i % 3) / 2.0f};
+            auto streamed = asset_streamer.request([sphere_path] { return MeshCodec::load(sphere_path); });
+            streamed_models.push_back(std::make_unique<StreamedModel>(streamed, stream_placeholder.get(), color, transform, view, projection));
+        }
+    };
+
+    // Pebbles on the ground around the main sphere, placed deterministically and never moved again.
+    void create_static_objects()
+    {
+        Mesh pebble = get_sphere_mesh(6, 8, 1.0f, glm::vec3{1.0f});
+        const glm::vec3 colors[3]{{0.45f, 0.42f, 0.38f}, {0.35f, 0.33f, 0.32f}, {0.5f, 0.45f, 0.35f}};
+        StaticBatcher batcher{STATIC_BATCH_CELL_SIZE};
+        for (uint32_t i = 0; i < STATIC_OBJECT_COUNT; i++)
+        {
+            float t = i / static_cast<float>(STATIC_OBJECT_COUNT);
+            float angle = t * 6.2831853f * 37.0f;
+            float distance = 0.45f + 0.5f * std::fmod(t * 91.3f, 1.0f);
+            float size = 0.008f + 0.012f * std::fmod(t * 17.9f, 1.0f);
+            glm::vec3 position{distance * std::cos(angle), -0.3f + size * 0.3f, distance * std::sin(angle)};
+            Transform transform{position, glm::vec3(0.0f, 1.0f, 0.0f), angle, glm::vec3(size, size * 0.6f, size * 1.3f)};
+            batcher.add(pebble, colors[i % 3], transform);
+        }
+        static_object_count = batcher.object_count();
+        static_batches = batcher.build(view, projection);
+    };
+
+    // Loads mesh_path and fits it into a sphere of the given radius around the origin, so it takes the
+    // main sphere's place whatever units it was authored in.
+    Mesh load_scene_mesh(float radius)
+    {
+        double start = glfwGetTime();
+        Mesh mesh = load_mesh(mesh_path, glm::vec3{0.5f, 0.1f, 0.2f});
+        Logger::get().info("Loaded {} in {} ms: {} vertices, {} triangles", mesh_path, (glfwGetTime() - start) * 1000.0, mesh.vertices.size(), mesh.indices.size() / 3);
+
+        Bounds bounds = get_mesh_bounds(mesh);
+        glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+        float extent = glm::length(bounds.max - center);
+        float scale = extent > 0.0f ? radius / extent : 1.0f;
+        for (auto &vertex : mesh.vertices)
+        {
+            vertex.position = (vertex.position - center) * scale;
+        }
+        return mesh;
+    };
+
+    // Maps a mesh from MESH_DIRECTORY, baking it first if it is missing or was written by another format version.
+    MeshFile open_baked_mesh(const std::string &name, const std::function<std::vector<Mesh>()> &bake)
+    {
+        std::filesystem::path path = std::filesystem::path{MESH_DIRECTORY} / name;
+        if (std::filesystem::exists(path))
+        {
+            try
+            {
+                return MeshFile{path};
+            }
+            catch (const std::runtime_error &error)
+            {
+                Logger::get().warning("{}, baking it again", error.what());
+            }
+        }
+        write_mesh_file(path, bake());
+        return MeshFile{path};
+    };
+
+    void create_point_lights()
+    {
+        clustered_lighting.init();
+        clustered_lighting.set_projection(projection, Z_NEAR, Z_FAR);
+
+        point_lights.resize(CLUSTERED_LIGHT_COUNT);
+        point_light_orbits.resize(CLUSTERED_LIGHT_COUNT);
+        for (uint32_t i = 0; i < CLUSTERED_LIGHT_COUNT; i++)
+        {
+            float t = i / static_cast<float>(CLUSTERED_LIGHT_COUNT);
+            // Orbit radius, height, angular speed and phase, spread deterministically over a shell around the sphere.
+            point_light_orbits[i] = glm::vec4(0.2f + 0.4f * std::fmod(t * 7.31f, 1.0f), 0.3f * std::sin(t * 53.0f), 0.3f + std::fmod(t * 3.7f, 1.0f), t * 6.2831853f);
+            glm::vec3 color{0.5f + 0.5f * std::sin(t * 12.0f), 0.5f + 0.5f * std::sin(t * 12.0f + 2.1f), 0.5f + 0.5f * std::sin(t * 12.0f + 4.2f)};
+            point_lights[i] = PointLight{glm::vec3(0.0f), 0.15f, color, 1.0f};
+        }
+    };
+
+    // Sphere LODs are generated right away. A loaded mesh (at unit radius) is simplified on the pool while
+    // the app starts, poll_gpu_driven_scene() initializes the scene once its LODs are ready.
+    void create_gpu_driven_scene(Mesh &&scene_mesh)
+    {
+        if (mesh_path.empty())
+        {
+            std::vector<Mesh> lods;
+            for (uint32_t segments : {32u, 16u, 8u, 4u})
+            {
+                lods.push_back(get_sphere_mesh(segments, segments, 1.0f, glm::vec3{0.2f, 0.5f, 0.3f}));
+            }
+            init_gpu_driven_scene(lods);
+            return;
+        }
+
+        // Loaded meshes have no tessellation parameter, their LODs are simplified at a quarter of the
+        // triangles per level, the same steps as the sphere LODs.
+        scene_mesh.color = glm::vec3{0.2f, 0.5f, 0.3f};
+        auto build = [mesh = std::move(scene_mesh)]
+        {
+            double start = glfwGetTime();
+            std::vector<Mesh> lods = MeshSimplifier::build_lod_chain(mesh, GpuDrivenScene::LOD_COUNT, 0.25f);
+            Logger::get().info("Simplified {} LODs in {} ms: {}, {}, {} triangles", lods.size() - 1, (glfwGetTime() - start) * 1000.0,
+                               lods[1].indices.size() / 3, lods[2].indices.size() / 3, lods[3].indices.size() / 3);
+            return lods;
+        };
+        // Without workers the pool would never run the job, simplify synchronously instead.
+        if (ThreadPool::get().thread_count() == 0)
+        {
+            init_gpu_driven_scene(build());
+        }
+        else
+        {
+            gpu_driven_lods = ThreadPool::get().submit(std::move(build));
+        }
+    };
+
+    // Hands the LODs to the scene once the pool has built them, runs on the GL thread every frame.
+    void poll_gpu_driven_scene()
+    {
+        if (!gpu_driven_lods.valid() || gpu_driven_lods.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            return;
+        }
+        try
+        {
+            init_gpu_driven_scene(gpu_driven_lods.get());
+        }
+        catch (const std::exception &e)
+        {
+            Logger::get().error("Building the GPU driven LODs failed: {}", e.what());
+        }
+    };
+
+    void init_gpu_driven_scene(const std::vector<Mesh> &lods)
+    {
+        // A field of spheres behind the main one, so it and the ground occlude part of it.
+        std::vector<glm::vec4> position_scales;
+        position_scales.reserve(GPU_DRIVEN_GRID_SIZE * GPU_DRIVEN_GRID_SIZE);
+        for (uint32_t z = 0; z < GPU_DRIVEN_GRID_SIZE; z++)
+        {
+            for (uint32_t x = 0; x < GPU_DRIVEN_GRID_SIZE; x++)
+            {
+                float offset = (x * 7 + z * 13) % 11 / 11.0f;
+                position_scales.push_back(glm::vec4((x - GPU_DRIVEN_GRID_SIZE / 2.0f) * 0.25f, -0.2f + 0.3f * offset, -1.0f - z * 0.25f, 0.05f + 0.05f * offset));
+            }
+        }
+        gpu_driven_scene.init(lods, position_scales, width, height);
+        gpu_driven_ready = true;
+    };
+
+    void update_point_lights()
+    {
+        float time = static_cast<float>(glfwGetTime());
+        for (size_t i = 0; i < point_lights.size(); i++)
+        {
+            const glm::vec4 &orbit = point_light_orbits[i];
+            float angle = orbit.w + time * orbit.z;
+            point_lights[i].position = glm::vec3(orbit.x * std::cos(angle), orbit.y, orbit.x * std::sin(angle));
+        }
     };
 
     void render()
     {
+        PROFILE_FUNCTION();
+        gpu_timer.begin_frame();
+
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        sphere_shader.use();
-        sphere_shader.set_vec3("light_color", glm::vec3(1.0f));
-        sphere_shader.set_vec3("input_color", sphere->get_color());
-        sphere_shader.set_vec3("light_position", sphere2->get_transform().translate);
-        sphere_shader.set_vec3("view_position", -camera_pos);
+        asset_streamer.update();
+        if (lighting_path != LightingPath::forward)
+        {
+            update_point_lights();
+        }
+        if (occlusion_culling_enabled)
+        {
+            occlusion_culler.begin_frame(projection * view);
+            occlusion_culler.add_occluder(*sphere);
+            occlusion_culler.add_occluder(*ground);
+            occlusion_culler.rasterize();
+        }
+        // Tested once per frame, every pass drawing the scene reuses the result.
+        FrameVector<Drawable *> visible_models{FrameArena::get().allocator<Drawable *>()};
+        visible_models.reserve(streamed_models.size() + static_batches.size());
+        for (auto &model : streamed_models)
+        {
+            if (is_visible(*model))
+            {
+                visible_models.push_back(model.get());
+            }
+        }
+        for (auto &batch : static_batches)
+        {
+            if (is_visible(*batch))
+            {
+                visible_models.push_back(batch.get());
+            }
+        }
+        if (shadows_enabled)
+        {
+            auto pass = gpu_timer.scope("shadow pass");
+            shadow_map.set_light_position(sphere2->get_transform().translate);
+            // Meshlets are culled against the camera, the cube map faces need all of them.
+            sphere->set_culling(false);
+            shadow_map.update(*shadow_shader);
+            sphere->set_culling(meshlet_culling_enabled);
+        }
+
+        if (lighting_path == LightingPath::deferred)
+        {
+            render_deferred(visible_models);
+        }
+        else
+        {
+            if (depth_prepass_enabled)
+            {
+                render_depth_prepass(visible_models);
+            }
+
+            auto pass = gpu_timer.scope("sphere pass");
+            bool clustered = lighting_path == LightingPath::clustered;
+            if (clustered)
+            {
+                clustered_lighting.update(point_lights, view);
+            }
+            Shader &shader = clustered ? *clustered_sphere_shader : *sphere_shader;
+            shader.use();
+            shader.set_vec3("light_color", glm::vec3(1.0f));
+            shader.set_vec3("input_color", sphere->get_color());
+            shader.set_vec3("light_position", sphere2->get_transform().translate);
+            shader.set_vec3("view_position", -camera_pos);
+            shadow_map.bind(shader, shadows_enabled);
+            if (clustered)
+            {
+                clustered_lighting.bind(shader, width, height);
+            }
+
+            draw_scene(shader, visible_models);
 
-        sphere->draw(sphere_shader);
+            if (depth_prepass_enabled)
+            {
+                glDepthFunc(GL_LESS);
+                glDepthMask(GL_TRUE);
+            }
+        }
+
+        if (gpu_driven_enabled)
+        {
+            render_gpu_driven();
+        }
+        if (tessellation_enabled && GLAD_EXTENSIONS.tessellation)
+        {
+            render_tessellated();
+        }
 
         float x{static_cast<float>(cos(glfwGetTime())) / 2.0f};
         float z{static_cast<float>(sin(glfwGetTime())) / 2.0f};
-        std::cout << cos(glfwGetTime()) << " " << sin(glfwGetTime()) << "\n";
+        Logger::get().trace("{} {}", x, z);
 
         auto transform{sphere2->get_transform()};
         transform.translate = glm::vec3(x, 0.0f, z);
 
         sphere2->update_transform(transform);
 
-        sphere2->draw(light_shader);
+        {
+            auto pass = gpu_timer.scope("light pass");
+            if (is_visible(*sphere2))
+            {
+                sphere2->draw(*light_shader);
+            }
+
+            if (lighting_path != LightingPath::forward)
+            {
+                auto marker_transform{light_marker->get_transform()};
+                for (const auto &light : point_lights)
+                {
+                    marker_transform.translate = light.position;
+                    light_marker->update_transform(marker_transform);
+                    if (is_visible(*light_marker))
+                    {
+                        light_marker->draw(*light_shader);
+                    }
+                }
+            }
+        }
+
+        if (gpu_driven_enabled)
+        {
+            auto pass = gpu_timer.scope("depth pyramid");
+            gpu_driven_scene.build_depth_pyramid(*depth_pyramid_shader, view, projection);
+        }
+
+        gpu_timer.end_frame();
+    };
+
+    // Culling, LOD selection and the draw of every instance cost a fixed number of GL calls.
+    void render_gpu_driven()
+    {
+        PROFILE_FUNCTION();
+        auto pass = gpu_timer.scope("gpu driven pass");
+        gpu_driven_scene.cull(*gpu_cull_shader, view, projection, -camera_pos);
+
+        gpu_driven_shader->use();
+        gpu_driven_shader->set_mat4("view", view);
+        gpu_driven_shader->set_mat4("projection", projection);
+        gpu_driven_shader->set_vec3("light_color", glm::vec3(1.0f));
+        gpu_driven_shader->set_vec3("input_color", glm::vec3(0.2f, 0.5f, 0.3f));
+        gpu_driven_shader->set_vec3("light_position", sphere2->get_transform().translate);
+        gpu_driven_shader->set_vec3("view_position", -camera_pos);
+        shadow_map.bind(*gpu_driven_shader, shadows_enabled);
+        gpu_driven_scene.draw(*gpu_driven_shader);
+    };
+
+    // Lit like the sphere pass, after it, so the depth pre-pass and the G-buffer never see the patches.
+    void render_tessellated()
+    {
+        PROFILE_FUNCTION();
+        auto pass = gpu_timer.scope("tessellation pass");
+        Shader &shader = *tessellated_sphere_shader;
+        TessellatedSphere::set_view_parameters(shader, height, TESSELLATION_EDGE_PIXELS);
+        shader.set_vec3("light_color", glm::vec3(1.0f));
+        shader.set_vec3("light_position", sphere2->get_transform().translate);
+        shader.set_vec3("view_position", -camera_pos);
+        shadow_map.bind(shader, shadows_enabled);
+        for (auto &tessellated_sphere : tessellated_spheres)
+        {
+            if (is_visible(*tessellated_sphere))
+            {
+                shader.set_vec3("input_color", tessellated_sphere->get_color());
+                tessellated_sphere->draw(shader);
+            }
+        }
+    };
+
+    bool is_visible(const Drawable &drawable)
+    {
+        return !occlusion_culling_enabled || occlusion_culler.is_visible(drawable);
+    };
+
+    // Lit geometry, shared by the depth pre-pass, the forward passes and the G-buffer pass.
+    void draw_scene(Shader &shader, const FrameVector<Drawable *> &visible_models)
+    {
+        shader.use();
+        shader.set_vec3("input_color", sphere->get_color());
+        sphere->draw(shader);
+        shader.set_vec3("input_color", ground->get_color());
+        ground->draw(shader);
+        for (Drawable *model : visible_models)
+        {
+            shader.set_vec3("input_color", model->get_color());
+            model->draw(shader);
+        }
+    };
+
+    // Writes depth only, then leaves the state for the lit pass: GL_EQUAL without depth writes, so only the
+    // front-most fragment of every pixel runs frag_shader.frag.
+    void render_depth_prepass(const FrameVector<Drawable *> &visible_models)
+    {
+        auto pass = gpu_timer.scope("depth pre-pass");
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        draw_scene(*depth_only_shader, visible_models);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+        glDepthFunc(GL_EQUAL);
+        glDepthMask(GL_FALSE);
+    };
+
+    // G-buffer pass for the sphere, then ambient and the main light over the full screen and one additive
+    // light volume per point light. Depth is copied back so the forward light pass still depth tests.
+    void render_deferred(const FrameVector<Drawable *> &visible_models)
+    {
+        PROFILE_FUNCTION();
+        {
+            auto pass = gpu_timer.scope("gbuffer pass");
+            deferred_shading.begin_geometry_pass();
+            draw_scene(*gbuffer_shader, visible_models);
+            deferred_shading.end_geometry_pass();
+        }
+
+        auto pass = gpu_timer.scope("deferred lighting pass");
+        deferred_shading.begin_lighting_pass();
+
+        deferred_shading.bind(*deferred_ambient_shader, view, projection);
+        shadow_map.bind(*deferred_ambient_shader, shadows_enabled);
+        deferred_ambient_shader->set_vec3("light_color", glm::vec3(1.0f));
+        deferred_ambient_shader->set_vec3("light_position", sphere2->get_transform().translate);
+        deferred_ambient_shader->set_vec3("view_position", -camera_pos);
+        deferred_shading.draw_fullscreen();
+
+        deferred_shading.begin_light_volumes();
+        deferred_shading.bind(*deferred_light_shader, view, projection);
+        shadow_map.bind(*deferred_light_shader, shadows_enabled);
+        deferred_light_shader->set_vec3("view_position", -camera_pos);
+        auto volume_transform{light_volume->get_transform()};
+        for (const auto &light : point_lights)
+        {
+            volume_transform.translate = light.position;
+            volume_transform.scale = glm::vec3(light.radius * LIGHT_VOLUME_SCALE);
+            light_volume->update_transform(volume_transform);
+            // A hidden volume can only light surfaces in front of it, which are outside its radius.
+            if (!is_visible(*light_volume))
+            {
+                continue;
+            }
+            deferred_light_shader->set_vec4("point_light", glm::vec4(light.position, light.radius));
+            deferred_light_shader->set_vec3("point_light_color", light.color * light.intensity);
+            light_volume->draw(*deferred_light_shader);
+        }
+
+        deferred_shading.end_lighting_pass();
+        deferred_shading.blit_depth();
+    };
+
+    // Shown while the shader programs are still compiling.
+    void render_loading()
+    {
+        float pulse{0.5f + 0.5f * static_cast<float>(sin(glfwGetTime() * 4.0))};
+        glClearColor(0.1f, 0.1f, 0.1f + 0.1f * pulse, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     };
 
     void update_variables()
     {
+        PROFILE_FUNCTION();
+
         delta_time = static_cast<float>(glfwGetTime()) - last_time;
         last_time = static_cast<float>(glfwGetTime());
     };
 
     void process_input()
     {
+        PROFILE_FUNCTION();
+
         if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         {
             glfwSetWindowShouldClose(window, true);
         }
+        if (key_triggered(GLFW_KEY_F1, capture_key_was_pressed))
+        {
+#if PROFILING_ENABLED
+            Profiler::get().request_capture(TRACE_PATH, TRACE_FRAME_COUNT);
+#else
+            Logger::get().warning("Trace capture needs a build with profiling, configure with ENABLE_PROFILING");
+#endif
+        }
+        if (key_triggered(GLFW_KEY_F2, report_key_was_pressed))
+        {
+            gpu_timer.log_report();
+            if (occlusion_culling_enabled)
+            {
+                Logger::get().info("Occlusion culling: {} of {} drawables culled", occlusion_culler.culled_count(), occlusion_culler.tested_count());
+            }
+            Logger::get().info("Streaming: {} meshes pending", asset_streamer.pending_count());
+            Logger::get().info("Meshlets: {} of {} drawn", sphere->drawn_count(), sphere->meshlet_count());
+            Logger::get().info("Static batching: {} objects in {} batches", static_object_count, static_batches.size());
+            Logger::get().info("Frame arena: {} KB used this frame, {} KB reserved", FrameArena::get().used_bytes() / 1024, FrameArena::get().capacity_bytes() / 1024);
+#if PROFILING_ENABLED
+            Logger::get().info("Heap allocations: {} last frame", frame_allocations);
+#endif
+        }
+        if (key_triggered(GLFW_KEY_F3, frame_capture_key_was_pressed))
+        {
+            if (frame_capture.is_active())
+            {
+                frame_capture.stop();
+            }
+            else
+            {
+                frame_capture.start(CAPTURE_DIRECTORY, width, height);
+            }
+        }
+        if (key_triggered(GLFW_KEY_F4, lighting_path_key_was_pressed))
+        {
+            const char *names[3]{"forward", "clustered", "deferred"};
+            lighting_path = static_cast<LightingPath>((static_cast<int32_t>(lighting_path) + 1) % 3);
+            Logger::get().info("Lighting path {} ({} point lights)", names[static_cast<int32_t>(lighting_path)], point_lights.size());
+        }
+        if (key_triggered(GLFW_KEY_F5, depth_prepass_key_was_pressed))
+        {
+            depth_prepass_enabled = !depth_prepass_enabled;
+            Logger::get().info("Depth pre-pass {}", depth_prepass_enabled ? "on" : "off");
+        }
+        if (key_triggered(GLFW_KEY_F6, shadows_key_was_pressed))
+        {
+            shadows_enabled = !shadows_enabled;
+            Logger::get().info("Shadows {}", shadows_enabled ? "on" : "off");
+        }
+        if (key_triggered(GLFW_KEY_F7, gpu_driven_key_was_pressed))
+        {
+            if (GLAD_EXTENSIONS.gpu_driven && !gpu_driven_ready)
+            {
+                Logger::get().info("GPU driven scene is still being built");
+            }
+            else if (GLAD_EXTENSIONS.gpu_driven)
+            {
+                gpu_driven_enabled = !gpu_driven_enabled;
+                Logger::get().info("GPU driven path {} ({} objects)", gpu_driven_enabled ? "on" : "off", gpu_driven_scene.get_object_count());
+            }
+            else
+            {
+                Logger::get().warning("GPU driven path needs OpenGL 4.3");
+            }
+        }
+        if (key_triggered(GLFW_KEY_F8, occlusion_culling_key_was_pressed))
+        {
+            occlusion_culling_enabled = !occlusion_culling_enabled;
+            Logger::get().info("Occlusion culling {}", occlusion_culling_enabled ? "on" : "off");
+        }
+        if (key_triggered(GLFW_KEY_F9, meshlet_culling_key_was_pressed))
+        {
+            meshlet_culling_enabled = !meshlet_culling_enabled;
+            sphere->set_culling(meshlet_culling_enabled);
+            Logger::get().info("Meshlet culling {} ({} meshlets)", meshlet_culling_enabled ? "on" : "off", sphere->meshlet_count());
+        }
+        if (key_triggered(GLFW_KEY_F10, tessellation_key_was_pressed))
+        {
+            if (GLAD_EXTENSIONS.tessellation)
+            {
+                tessellation_enabled = !tessellation_enabled;
+                Logger::get().info("Tessellated spheres {}", tessellation_enabled ? "on" : "off");
+            }
+            else
+            {
+                Logger::get().warning("Tessellated spheres need OpenGL 4.0");
+            }
+        }
         if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
         {
             sphere->rotate(glm::vec3(0.0f, 1.0f, 0.0f), rotate_angle * delta_time);
@@ -208,6 +1018,15 @@ private:
         }
     };
 
+    // True only on the frame the key goes down.
+    bool key_triggered(int32_t key, bool &was_pressed)
+    {
+        bool pressed = glfwGetKey(window, key) == GLFW_PRESS;
+        bool triggered = pressed && !was_pressed;
+        was_pressed = pressed;
+        return triggered;
+    };
+
     static void framebuffer_size_callback(GLFWwindow *window, int32_t _width, int32_t _height)
     {
         auto app = reinterpret_cast<OpenGlApp *>(glfwGetWindowUserPointer(window));
@@ -218,9 +1037,16 @@ private:
         width = _width;
         height = _height;
         glViewport(0, 0, width, height);
+        frame_capture.resize(width, height);
 
-        projection = glm::perspective(glm::radians(45.0f), width / static_cast<float>(height), 0.1f, 100.0f);
-        sphere_shader.set_mat4("projection", projection);
+        projection = glm::perspective(glm::radians(FIELD_OF_VIEW), width / static_cast<float>(height), Z_NEAR, Z_FAR);
+        sphere_shader->set_mat4("projection", projection);
+        clustered_lighting.set_projection(projection, Z_NEAR, Z_FAR);
+        deferred_shading.resize(width, height);
+        if (gpu_driven_ready)
+        {
+            gpu_driven_scene.resize(width, height);
+        }
     };
 
     int clamp(int32_t value, int32_t lowest, int32_t highest)
@@ -237,16 +1063,16 @@ private:
     };
 };
 
-int main()
+int main(int argc, char **argv)
 {
-    OpenGlApp app{WINDOW_NAME, WIDTH, HEIGHT};
+    OpenGlApp app{WINDOW_NAME, WIDTH, HEIGHT, argc > 1 ? argv[1] : ""};
     try
     {
         app.run();
     }
     catch (const std::exception &e)
     {
-        std::cerr << e.what() << "\n";
+        Logger::get().error("{}", e.what());
         return 1;
     }
 
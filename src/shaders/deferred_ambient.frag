@@ -0,0 +1,27 @@
+#version 330 core
+#include "lighting.glsl"
+#include "gbuffer.glsl"
+out vec4 frag_color;
+
+uniform vec3 light_color;
+uniform vec3 view_position;
+
+// Ambient plus the LIGHT_COUNT unbounded lights, the same terms frag_shader.frag computes in the forward path.
+void main()
+{
+    GBufferSample gbuffer;
+    if (!read_gbuffer(gbuffer))
+    {
+        discard;
+    }
+    vec3 view_direction = normalize(view_position - gbuffer.position);
+
+    vec3 result = AMBIENT_STRENGTH * light_color;
+    for (int i = 0; i < LIGHT_COUNT; i++)
+    {
+        vec3 light_direction = normalize(light_position[i] - gbuffer.position);
+        result += shade_light(gbuffer.normal, view_direction, light_direction, light_color) * light_visibility(i, gbuffer.position);
+    }
+
+    frag_color = vec4(result * gbuffer.albedo, 1.0f);
+}
\ No newline at end of file
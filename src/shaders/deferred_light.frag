@@ -0,0 +1,29 @@
+#version 330 core
+#include "lighting.glsl"
+#include "gbuffer.glsl"
+out vec4 frag_color;
+
+// The light this volume bounds, position and radius in world space.
+uniform vec4 point_light;
+uniform vec3 point_light_color;
+uniform vec3 view_position;
+
+void main()
+{
+    GBufferSample gbuffer;
+    if (!read_gbuffer(gbuffer))
+    {
+        discard;
+    }
+    vec3 to_light = point_light.xyz - gbuffer.position;
+    float distance = length(to_light);
+    if (distance >= point_light.w)
+    {
+        discard;
+    }
+    vec3 view_direction = normalize(view_position - gbuffer.position);
+    float falloff = point_light_falloff(distance, point_light.w);
+    vec3 result = shade_light(gbuffer.normal, view_direction, to_light / max(distance, 0.0001f), vec3(1.0f)) * point_light_color * falloff;
+
+    frag_color = vec4(result * gbuffer.albedo, 1.0f);
+}
\ No newline at end of file
@@ -0,0 +1,14 @@
+#version 330 core
+layout (location = 0) in vec3 input_position;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+// Must match vert_shader.vert exactly so the color pass passes the GL_EQUAL depth test.
+invariant gl_Position;
+
+void main()
+{
+    gl_Position = projection * view * model * vec4(input_position, 1.0f);
+}
\ No newline at end of file
@@ -0,0 +1,14 @@
+#version 330 core
+layout (location = 0) out vec4 gbuffer_normal_output;
+layout (location = 1) out vec4 gbuffer_albedo_output;
+
+uniform vec3 input_color;
+
+in vec3 normal;
+in vec3 frag_pos;
+
+void main()
+{
+    gbuffer_normal_output = vec4(normalize(normal), 0.0f);
+    gbuffer_albedo_output = vec4(input_color, 1.0f);
+}
\ No newline at end of file
@@ -0,0 +1,29 @@
+// G-buffer written by gbuffer.frag, bound by DeferredShading::bind.
+uniform sampler2D gbuffer_normal;
+uniform sampler2D gbuffer_albedo;
+uniform sampler2D gbuffer_depth;
+uniform mat4 inverse_view_projection;
+uniform vec2 viewport_size;
+
+struct GBufferSample
+{
+    vec3 position;
+    vec3 normal;
+    vec3 albedo;
+};
+
+// Reads the pixel under gl_FragCoord, returns false where no geometry was drawn.
+bool read_gbuffer(out GBufferSample gbuffer)
+{
+    vec2 uv = gl_FragCoord.xy / viewport_size;
+    float depth = texture(gbuffer_depth, uv).r;
+    if (depth >= 1.0f)
+    {
+        return false;
+    }
+    vec4 position = inverse_view_projection * vec4(vec3(uv, depth) * 2.0f - 1.0f, 1.0f);
+    gbuffer.position = position.xyz / position.w;
+    gbuffer.normal = normalize(texture(gbuffer_normal, uv).xyz);
+    gbuffer.albedo = texture(gbuffer_albedo, uv).rgb;
+    return true;
+}
\ No newline at end of file
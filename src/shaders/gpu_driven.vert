@@ -0,0 +1,30 @@
+#version 430 core
+layout (location = 0) in vec3 input_position;
+layout (location = 1) in vec3 input_normal;
+// Index into objects, taken from the visible list written by gpu_cull.comp.
+layout (location = 2) in uint object_index;
+
+struct ObjectData
+{
+    vec4 position_scale;
+    vec4 bounds;
+};
+
+layout (std430, binding = 0) readonly buffer Objects
+{
+    ObjectData objects[];
+};
+
+uniform mat4 view;
+uniform mat4 projection;
+
+out vec3 normal;
+out vec3 frag_pos;
+
+void main()
+{
+    vec4 position_scale = objects[object_index].position_scale;
+    frag_pos = input_position * position_scale.w + position_scale.xyz;
+    normal = input_normal;
+    gl_Position = projection * view * vec4(frag_pos, 1.0f);
+}
\ No newline at end of file
@@ -0,0 +1,114 @@
+// Lighting options, set per permutation by ShaderPreprocessor defines.
+#define SHADING_PHONG 0
+#define SHADING_BLINN_PHONG 1
+#define SHADING_LAMBERT 2
+
+#ifndef LIGHT_COUNT
+#define LIGHT_COUNT 1
+#endif
+#ifndef SPECULAR
+#define SPECULAR 1
+#endif
+#ifndef SHADING_MODEL
+#define SHADING_MODEL SHADING_PHONG
+#endif
+#ifndef AMBIENT_STRENGTH
+#define AMBIENT_STRENGTH 0.1f
+#endif
+#ifndef SPECULAR_STRENGTH
+#define SPECULAR_STRENGTH 0.5f
+#endif
+#ifndef SHININESS
+#define SHININESS 32.0f
+#endif
+#ifndef CLUSTERED
+#define CLUSTERED 0
+#endif
+#ifndef SHADOWS
+#define SHADOWS 0
+#endif
+
+uniform vec3 light_position[LIGHT_COUNT];
+
+// Diffuse plus specular contribution of one light, ambient is added once by the caller.
+vec3 shade_light(vec3 norm, vec3 view_direction, vec3 light_direction, vec3 light_color)
+{
+    float diffuse = max(dot(norm, light_direction), 0.0f);
+    vec3 result = vec3(diffuse);
+#if SPECULAR && SHADING_MODEL != SHADING_LAMBERT
+#if SHADING_MODEL == SHADING_BLINN_PHONG
+    vec3 halfway_direction = normalize(light_direction + view_direction);
+    float specular_coef = pow(max(dot(norm, halfway_direction), 0.0f), SHININESS);
+#else
+    vec3 reflected_direction = reflect(-light_direction, norm);
+    float specular_coef = pow(max(dot(view_direction, reflected_direction), 0.0f), SHININESS);
+#endif
+    result += SPECULAR_STRENGTH * specular_coef * light_color;
+#endif
+    return result;
+}
+
+#if SHADOWS
+// Cube of linear light distances written by shadow.frag, bound by PointShadowMap::bind.
+uniform samplerCube shadow_map;
+uniform float shadow_far_plane;
+uniform bool shadows_enabled;
+#endif
+
+// 0 where light i is blocked, only light 0 casts shadows.
+float light_visibility(int i, vec3 frag_pos)
+{
+#if SHADOWS
+    if (i == 0 && shadows_enabled)
+    {
+        vec3 to_fragment = frag_pos - light_position[0];
+        float closest = texture(shadow_map, to_fragment).r * shadow_far_plane;
+        float bias = 0.01f;
+        return length(to_fragment) - bias > closest ? 0.0f : 1.0f;
+    }
+#endif
+    return 1.0f;
+}
+
+// Point light attenuation, windowed so it reaches zero exactly at the light radius.
+float point_light_falloff(float distance, float radius)
+{
+    float falloff = clamp(1.0f - pow(distance / radius, 4.0f), 0.0f, 1.0f);
+    return falloff * falloff / (distance * distance + 1.0f);
+}
+
+#if CLUSTERED
+// Cluster dimensions (CLUSTER_TILES_X, CLUSTER_TILES_Y, CLUSTER_DEPTH_SLICES) are injected by ClusteredLighting.
+uniform usamplerBuffer cluster_grid;
+uniform usamplerBuffer cluster_light_indices;
+uniform samplerBuffer cluster_lights;
+uniform vec2 cluster_tile_size;
+uniform vec2 cluster_depth_range;
+uniform vec2 cluster_slice_transform;
+
+// Sum of the point lights binned into the cluster that contains this fragment.
+vec3 shade_clustered(vec3 norm, vec3 view_direction, vec3 frag_pos)
+{
+    float z_near = cluster_depth_range.x;
+    float z_far = cluster_depth_range.y;
+    float depth = 2.0f * z_near * z_far / (z_far + z_near - (gl_FragCoord.z * 2.0f - 1.0f) * (z_far - z_near));
+    int slice = int(clamp(floor(log(depth) * cluster_slice_transform.x + cluster_slice_transform.y), 0.0f, float(CLUSTER_DEPTH_SLICES - 1)));
+    ivec2 tile = ivec2(min(gl_FragCoord.xy / cluster_tile_size, vec2(CLUSTER_TILES_X - 1, CLUSTER_TILES_Y - 1)));
+    int cluster = (slice * CLUSTER_TILES_Y + tile.y) * CLUSTER_TILES_X + tile.x;
+
+    uvec2 range = texelFetch(cluster_grid, cluster).xy;
+    vec3 result = vec3(0.0f);
+    for (uint i = 0u; i < range.y; i++)
+    {
+        int light = int(texelFetch(cluster_light_indices, int(range.x + i)).x);
+        vec4 position_radius = texelFetch(cluster_lights, light * 2);
+        vec3 color = texelFetch(cluster_lights, light * 2 + 1).rgb;
+
+        vec3 to_light = position_radius.xyz - frag_pos;
+        float distance = length(to_light);
+        float falloff = point_light_falloff(distance, position_radius.w);
+        result += shade_light(norm, view_direction, to_light / max(distance, 0.0001f), vec3(1.0f)) * color * falloff;
+    }
+    return result;
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,11 @@
+#version 330 core
+in vec3 world_position;
+
+uniform vec3 light_position;
+uniform float shadow_far_plane;
+
+// Linear distance to the light, compared against the same value in point_shadow.
+void main()
+{
+    gl_FragDepth = length(world_position - light_position) / shadow_far_plane;
+}
\ No newline at end of file
@@ -0,0 +1,10 @@
+#version 330 core
+layout (location = 0) in vec3 input_position;
+
+uniform mat4 model;
+
+// World space, shadow.geom projects every triangle once per cube face.
+void main()
+{
+    gl_Position = model * vec4(input_position, 1.0f);
+}
\ No newline at end of file
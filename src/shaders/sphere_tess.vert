@@ -0,0 +1,11 @@
+#version 400 core
+layout (location = 0) in vec3 input_position;
+layout (location = 1) in vec3 input_normal;
+
+// Patch corners stay in mesh space, sphere_tess.tese places the generated vertices.
+out vec3 control_position;
+
+void main()
+{
+    control_position = input_position;
+}
@@ -9,6 +9,9 @@ uniform mat4 projection;
 out vec3 normal;
 out vec3 frag_pos;
 
+// The depth pre-pass in depth_only.vert computes the same position, see OpenGlApp::render_depth_prepass.
+invariant gl_Position;
+
 void main()
 {
     gl_Position = projection * view * model * vec4(input_position, 1.0f);